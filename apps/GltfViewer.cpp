@@ -2,6 +2,7 @@
 #include "Vertex.h"
 #include "Model.h"
 #include "BaseMaterial.h"
+#include "RenderQueue.h"
 
 class GltfViewer : public mvk::AppBase
 {
@@ -20,10 +21,18 @@ class GltfViewer : public mvk::AppBase
 	}
 	pipelines;
 
+	// Only the skybox is drawn until the model is loaded
+	std::shared_future<void> sceneLoading;
+	bool sceneReady = false;
+
+	mvk::RenderQueue renderQueue;
+
 public:
 	GltfViewer() : AppBase(mvk::AppInfo{
 		.appName = "GltfViewer",
 		//.fullscreen = true
+		// Draw order depends on the camera, it is sorted every frame
+		.recordEveryFrame = true
 	})
 	{
 		scene.camera.setPerspective(45.0f, float(width) / float(height),
@@ -55,15 +64,54 @@ public:
 		//const auto modelPath = "assets/models/lantern/lantern.gltf";
 		//const auto modelPath = "assets/models/buggy/buggy.gltf";
 
-		models.scene.loadFromFile(&device, transferQueue, modelPath);
+		const mvk::ModelLoadInfo loadInfo{
+			.optimizeMeshes = true,
+			.vertexFormat = mvk::VertexFormat::ePacked
+		};
+
+		sceneLoading = models.scene.loadFromFileAsync(&device, transferQueue,
+		                                              modelPath, loadInfo);
+	}
+
+	~GltfViewer()
+	{
+		skybox.release();
+		models.scene.release();
+
+		if (sceneReady)
+		{
+			pipelines.opaque.release();
+			pipelines.alpha.release();
+		}
+	}
+
+	void onUpdate() override
+	{
+		if (sceneReady)
+		{
+			models.scene.updateTransforms(currentFrame);
+			return;
+		}
+
+		if (!models.scene.isReady())
+		{
+			return;
+		}
 
-		const std::vector<vk::VertexInputBindingDescription> bindingDescription
-			= {
-				mvk::Vertex::getBindingDescription()
-			};
+		// Rethrows a failed load
+		sceneLoading.get();
 
-		const auto& attributeDescriptions =
-			mvk::Vertex::getAttributeDescriptions();
+		// Drawn from the command buffer recorded right after this update
+		createPipelines();
+		sceneReady = true;
+	}
+
+	void createPipelines()
+	{
+		const auto bindingDescription = models.scene.getBindingDescriptions();
+
+		const auto attributeDescriptions =
+			models.scene.getAttributeDescriptions();
 
 		const std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = {
 			scene.descriptorSetLayout,
@@ -86,7 +134,8 @@ public:
 			.shaderStageCreateInfos = shaderStageInfo,
 			.descriptorSetLayouts = descriptorSetLayouts,
 			.pushConstantRanges = pushConstantRanges,
-			.frontFace = vk::FrontFace::eCounterClockwise
+			.frontFace = vk::FrontFace::eCounterClockwise,
+			.vertexFormat = models.scene.getVertexFormat()
 		};
 
 		pipelines.opaque.build(&device, opaquePipelineCreateInfo);
@@ -100,18 +149,46 @@ public:
 			.descriptorSetLayouts = descriptorSetLayouts,
 			.pushConstantRanges = pushConstantRanges,
 			.frontFace = vk::FrontFace::eCounterClockwise,
-			.alpha = true
+			.alpha = true,
+			.vertexFormat = models.scene.getVertexFormat()
 		};
 
 		pipelines.alpha.build(&device, alphaPipelineCreateInfo);
 	}
 
-	~GltfViewer()
+	void queueScene()
 	{
-		skybox.release();
-		models.scene.release();
-		pipelines.opaque.release();
-		pipelines.alpha.release();
+		for (const auto& node : models.scene.nodes)
+		{
+			if (!node.hasMesh) continue;
+
+			const auto material =
+				dynamic_cast<mvk::BaseMaterial*>(
+					models.scene.materials.at(node.matId));
+
+			const auto blended =
+				material->alphaMode == mvk::AlphaMode::ALPHA_BLEND;
+
+			renderQueue.push({
+				.pipeline = blended ? &pipelines.alpha : &pipelines.opaque,
+				.material = material,
+				.model = &models.scene,
+				.node = &node,
+				.descriptorSets = {
+					scene.getDescriptorSet(currentFrame),
+					models.scene.getDescriptorSet(),
+					material->getDescriptorSet()
+				},
+				.descriptorSetCount = 3,
+				.dynamicSet = 1,
+				.dynamicOffset =
+				models.scene.getDynamicOffset(&node, currentFrame),
+				.pushConstants = &material->constants,
+				.pushConstantsSize = sizeof(mvk::BaseMaterial::PushConstants),
+				.depth = models.scene.getViewDepth(&node, scene.camera),
+				.blended = blended
+			});
+		}
 	}
 
 	void buildCommandBuffer(const vk::CommandBuffer commandBuffer,
@@ -139,107 +216,47 @@ public:
 			.pClearValues = clearValues.data()
 		};
 
-		commandBuffer.beginRenderPass(renderPassBeginInfo,
-		                              vk::SubpassContents::eInline);
-
-		vk::Viewport viewport = {
-			.x = 0.0f,
-			.y = 0.0f,
-			.width = static_cast<float>(width),
-			.height = static_cast<float>(height),
-			.minDepth = 0.0f,
-			.maxDepth = 1.0f
-		};
-
-		commandBuffer.setViewport(0, viewport);
+		commandBuffer.beginRenderPass(
+			renderPassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
 
-		vk::Rect2D scissor = {
-			.offset = {0, 0},
-			.extent = swapchain.getSwapchainExtent()
-		};
+		renderQueue.clear();
 
-		commandBuffer.setScissor(0, scissor);
+		if (sceneReady)
+		{
+			queueScene();
+		}
 
-		scene.renderSkybox(commandBuffer);
+		renderQueue.sort();
 
-		renderPipeline(commandBuffer, pipelines.opaque,
-		               mvk::AlphaMode::NO_ALPHA);
+		// The skybox is draw 0
+		const auto drawCount = 1 + renderQueue.size();
 
-		renderPipeline(commandBuffer, pipelines.alpha,
-		               mvk::AlphaMode::ALPHA_BLEND);
+		recordInParallel(commandBuffer, framebuffer, drawCount,
+		                 [this](const vk::CommandBuffer secondary,
+		                        const uint32_t first, const uint32_t count)
+		                 {
+			                 recordDraws(secondary, first, count);
+		                 });
 
 		commandBuffer.endRenderPass();
 		commandBuffer.end();
 	}
 
-	void renderPipeline(const vk::CommandBuffer commandBuffer,
-	                    const mvk::GraphicPipeline graphicPipeline,
-	                    const mvk::AlphaMode alphaMode)
+	// Runs on a recording thread, reads the queue only
+	void recordDraws(const vk::CommandBuffer commandBuffer, uint32_t first,
+	                 uint32_t count)
 	{
-		const auto pipelineLayout = graphicPipeline.getPipelineLayout();
-		const auto pipeline = graphicPipeline.getPipeline();
-
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-		                           pipeline);
-
-		for (const auto& node : models.scene.nodes)
+		if (first == 0)
 		{
-			renderNode(commandBuffer, node, pipelineLayout, alphaMode);
-		}
-	}
-
-	void renderNode(const vk::CommandBuffer commandBuffer, mvk::Node* node,
-	                const vk::PipelineLayout pipelineLayout,
-	                const mvk::AlphaMode alphaMode)
-	{
-		if (!node->hasMesh) return;
-
-		const auto material =
-			dynamic_cast<mvk::BaseMaterial*>(
-				models.scene.materials.at(node->matId));
-
-		if (material->alphaMode != alphaMode) return;
-
-		std::vector<vk::DescriptorSet> descriptorSets = {
-			scene.getDescriptorSet(0),
-			node->getDescriptorSet(),
-			material->getDescriptorSet()
-		};
-
-		const auto descriptorCount =
-			static_cast<uint32_t>(descriptorSets.size());
-
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-		                                 pipelineLayout, 0, descriptorCount,
-		                                 descriptorSets.data(), 0, nullptr);
-
-		commandBuffer.pushConstants(pipelineLayout,
-		                            vk::ShaderStageFlagBits::eFragment,
-		                            0, sizeof(mvk::BaseMaterial::PushConstants),
-		                            &material->constants);
-
-		const auto vertexBuffer = models.scene.vertexBuffer;
-		const auto indexBuffer = models.scene.indexBuffer;
-
-		vk::DeviceSize offsets[] = {0};
-
-		commandBuffer.
-			bindVertexBuffers(0, 1, &vertexBuffer.buffer, offsets);
-
-		if (node->hasIndices)
-		{
-			commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0,
-			                              vk::IndexType::eUint32);
-
-			commandBuffer.
-				drawIndexed(node->indexCount, 1,
-				            node->startIndex, 0, 0);
+			scene.renderSkybox(commandBuffer, currentFrame);
+			count--;
 		}
 		else
 		{
-			commandBuffer.draw(node->vertexCount, 1,
-			                   node->startVertex, 0);
+			first--;
 		}
+
+		renderQueue.execute(commandBuffer, first, count);
 	}
 };
 
@@ -3,6 +3,7 @@
 #include "BaseMaterial.h"
 #include "NormalMaterial.h"
 #include "GraphicPipeline.h"
+#include "RenderQueue.h"
 
 class MultiViewer : public mvk::AppBase
 {
@@ -37,6 +38,11 @@ class MultiViewer : public mvk::AppBase
 	}
 	pipelines;
 
+	// Largest screen space error a level of detail may have, in pixels
+	float lodPixelError = 1.0f;
+
+	mvk::RenderQueue renderQueue;
+
 	void loadGanesh()
 	{
 		const auto modelPath = "assets/models/ganesha/ganesha.obj";
@@ -47,16 +53,22 @@ class MultiViewer : public mvk::AppBase
 		const auto roughnessPath =
 			"assets/models/ganesha/textures/Ganesha_Roughness.jpg";
 
-		models.ganesh.loadFromFile(&device, transferQueue, modelPath);
+		const mvk::ModelLoadInfo loadInfo{
+			.optimizeMeshes = true,
+			.lodCount = 4,
+			.vertexFormat = mvk::VertexFormat::ePacked
+		};
+
+		models.ganesh.loadFromFile(&device, transferQueue, modelPath, loadInfo);
 
-		textures.albedo.loadFromFile(&device, transferQueue, albedoPath,
-		                             vk::Format::eR8G8B8A8Unorm);
+		textures.albedo.loadCooked(&device, transferQueue, albedoPath,
+		                           mvk::TextureUsage::eColor);
 
-		textures.normal.loadFromFile(&device, transferQueue, normalPath,
-		                             vk::Format::eR8G8B8A8Unorm);
+		textures.normal.loadCooked(&device, transferQueue, normalPath,
+		                           mvk::TextureUsage::eNormal);
 
-		textures.roughness.loadFromFile(&device, transferQueue, roughnessPath,
-		                                vk::Format::eR8G8B8A8Unorm);
+		textures.roughness.loadCooked(&device, transferQueue, roughnessPath,
+		                              mvk::TextureUsage::eLinear);
 
 		mvk::BaseMaterial::BaseMaterialDescription description{
 			.constants{
@@ -70,13 +82,10 @@ class MultiViewer : public mvk::AppBase
 
 		materials.standard.load(&device, description);
 
-		const std::vector<vk::VertexInputBindingDescription> bindingDescription
-			= {
-				mvk::Vertex::getBindingDescription()
-			};
+		const auto bindingDescription = models.ganesh.getBindingDescriptions();
 
-		const auto& attributeDescriptions =
-			mvk::Vertex::getAttributeDescriptions();
+		const auto attributeDescriptions =
+			models.ganesh.getAttributeDescriptions();
 
 		const std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = {
 			scene.descriptorSetLayout,
@@ -99,7 +108,8 @@ class MultiViewer : public mvk::AppBase
 			.shaderStageCreateInfos = shaderStageInfo,
 			.descriptorSetLayouts = descriptorSetLayouts,
 			.pushConstantRanges = pushConstantRanges,
-			.frontFace = vk::FrontFace::eCounterClockwise
+			.frontFace = vk::FrontFace::eCounterClockwise,
+			.vertexFormat = models.ganesh.getVertexFormat()
 		};
 
 		pipelines.standard.build(&device, opaquePipelineCreateInfo);
@@ -152,13 +162,10 @@ class MultiViewer : public mvk::AppBase
 
 		materials.normal.load(&device);
 
-		const std::vector<vk::VertexInputBindingDescription> bindingDescription
-			= {
-				mvk::Vertex::getBindingDescription()
-			};
+		const auto bindingDescription = models.plane.getBindingDescriptions();
 
-		const auto& attributeDescriptions =
-			mvk::Vertex::getAttributeDescriptions();
+		const auto attributeDescriptions =
+			models.plane.getAttributeDescriptions();
 
 		const std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = {
 			scene.descriptorSetLayout,
@@ -183,7 +190,8 @@ class MultiViewer : public mvk::AppBase
 
 public:
 	MultiViewer() : AppBase(mvk::AppInfo{
-		.appName = "MultiViewer"
+		.appName = "MultiViewer",
+		.recordEveryFrame = true
 	})
 	{
 		scene.camera.setPerspective(45.0f, float(width) / float(height),
@@ -225,6 +233,12 @@ public:
 		pipelines.normal.release();
 	}
 
+	void onUpdate() override
+	{
+		models.ganesh.updateTransforms(currentFrame);
+		models.plane.updateTransforms(currentFrame);
+	}
+
 	void buildCommandBuffer(const vk::CommandBuffer commandBuffer,
 	                        const vk::Framebuffer framebuffer) override
 	{
@@ -270,97 +284,66 @@ public:
 
 		commandBuffer.setScissor(0, scissor);
 
-		scene.renderSkybox(commandBuffer);
+		scene.renderSkybox(commandBuffer, currentFrame);
 
-		drawGanesh(commandBuffer);
-		drawPlane(commandBuffer);
+		renderQueue.clear();
+
+		queueGanesh(viewport.height);
+		queuePlane();
+
+		renderQueue.sort();
+		renderQueue.execute(commandBuffer);
 
 		commandBuffer.endRenderPass();
 		commandBuffer.end();
 	}
 
-	void drawGanesh(const vk::CommandBuffer commandBuffer)
+	void queueGanesh(const float viewportHeight)
 	{
-		const auto graphicPipeline = pipelines.standard;
-		const auto pipeline = graphicPipeline.getPipeline();
-		const auto pipelineLayout = graphicPipeline.getPipelineLayout();
-
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-		                           pipeline);
-
 		for (const auto& node : models.ganesh.nodes)
 		{
-			std::vector<vk::DescriptorSet> descriptorSets = {
-				scene.getDescriptorSet(0),
-				node->getDescriptorSet(),
-				materials.standard.getDescriptorSet()
-			};
-
-			const auto descriptorCount =
-				static_cast<uint32_t>(descriptorSets.size());
-
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			                                 pipelineLayout, 0, descriptorCount,
-			                                 descriptorSets.data(), 0, nullptr);
-
-			commandBuffer.pushConstants(pipelineLayout,
-			                            vk::ShaderStageFlagBits::eFragment, 0,
-			                            sizeof(mvk::BaseMaterial::PushConstants
-			                            ),
-			                            &materials.standard.constants);
-
-			const auto vertexBuffer = models.ganesh.vertexBuffer;
-			const auto indexBuffer = models.ganesh.indexBuffer;
-
-			vk::DeviceSize offsets[] = {0};
-
-			commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer.buffer,
-			                                offsets);
-
-			commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0,
-			                              vk::IndexType::eUint32);
-
-			commandBuffer.drawIndexed(node->indexCount, 1,
-			                          node->startIndex, 0, 0);
+			renderQueue.push({
+				.pipeline = &pipelines.standard,
+				.material = &materials.standard,
+				.model = &models.ganesh,
+				.node = &node,
+				.lod = models.ganesh.selectLod(&node, scene.camera,
+				                               viewportHeight, lodPixelError),
+				.descriptorSets = {
+					scene.getDescriptorSet(currentFrame),
+					models.ganesh.getDescriptorSet(),
+					materials.standard.getDescriptorSet()
+				},
+				.descriptorSetCount = 3,
+				.dynamicSet = 1,
+				.dynamicOffset =
+				models.ganesh.getDynamicOffset(&node, currentFrame),
+				.pushConstants = &materials.standard.constants,
+				.pushConstantsSize = sizeof(mvk::BaseMaterial::PushConstants),
+				.depth = models.ganesh.getViewDepth(&node, scene.camera)
+			});
 		}
 	}
 
-	void drawPlane(const vk::CommandBuffer commandBuffer)
+	void queuePlane()
 	{
-		const auto graphicPipeline = pipelines.normal;
-		const auto pipeline = graphicPipeline.getPipeline();
-		const auto pipelineLayout = graphicPipeline.getPipelineLayout();
-
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-		                           pipeline);
-
 		for (const auto& node : models.plane.nodes)
 		{
-			std::vector<vk::DescriptorSet> descriptorSets = {
-				scene.getDescriptorSet(0),
-				node->getDescriptorSet()
-			};
-
-			const auto descriptorCount = static_cast<uint32_t>(
-				descriptorSets.size());
-
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			                                 pipelineLayout, 0, descriptorCount,
-			                                 descriptorSets.data(), 0, nullptr);
-
-			const auto vertexBuffer = models.plane.vertexBuffer;
-			const auto indexBuffer = models.plane.indexBuffer;
-
-			vk::DeviceSize offsets[] = {0};
-
-			commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer.buffer,
-			                                offsets);
-
-			commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0,
-			                              vk::IndexType::eUint32);
-
-			commandBuffer.drawIndexed(node->indexCount, 1,
-			                          node->startIndex, 0, 0);
+			renderQueue.push({
+				.pipeline = &pipelines.normal,
+				.material = &materials.normal,
+				.model = &models.plane,
+				.node = &node,
+				.descriptorSets = {
+					scene.getDescriptorSet(currentFrame),
+					models.plane.getDescriptorSet()
+				},
+				.descriptorSetCount = 2,
+				.dynamicSet = 1,
+				.dynamicOffset =
+				models.plane.getDynamicOffset(&node, currentFrame),
+				.depth = models.plane.getViewDepth(&node, scene.camera)
+			});
 		}
 	}
 };
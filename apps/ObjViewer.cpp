@@ -3,6 +3,7 @@
 #include "Texture2D.h"
 #include "BaseMaterial.h"
 #include "GraphicPipeline.h"
+#include "RenderQueue.h"
 
 class ObjViewer : public mvk::AppBase
 {
@@ -34,9 +35,19 @@ class ObjViewer : public mvk::AppBase
 	}
 	pipelines;
 
+	// Largest screen space error a level of detail may have, in pixels
+	float lodPixelError = 1.0f;
+
+	// Draws the meshlets facing the camera instead of a level of detail
+	bool meshletCulling = false;
+
+	mvk::RenderQueue renderQueue;
+	std::vector<mvk::MeshLod> visibleRanges;
+
 public:
 	ObjViewer(): AppBase(mvk::AppInfo{
-		.appName = "ObjViewer"
+		.appName = "ObjViewer",
+		.recordEveryFrame = true
 	})
 	{
 		scene.camera.setPerspective(45.0f, float(width) / float(height),
@@ -70,16 +81,22 @@ public:
 		const auto roughnessPath =
 			"assets/models/ganesha/textures/Ganesha_Roughness.jpg";
 
-		models.ganesh.loadFromFile(&device, transferQueue, modelPath);
+		const mvk::ModelLoadInfo loadInfo{
+			.optimizeMeshes = true,
+			.lodCount = 4,
+			.vertexFormat = mvk::VertexFormat::ePacked
+		};
+
+		models.ganesh.loadFromFile(&device, transferQueue, modelPath, loadInfo);
 
-		textures.albedo.loadFromFile(&device, transferQueue, albedoPath,
-		                             vk::Format::eR8G8B8A8Unorm);
+		textures.albedo.loadCooked(&device, transferQueue, albedoPath,
+		                           mvk::TextureUsage::eColor);
 
-		textures.normal.loadFromFile(&device, transferQueue, normalPath,
-		                             vk::Format::eR8G8B8A8Unorm);
+		textures.normal.loadCooked(&device, transferQueue, normalPath,
+		                           mvk::TextureUsage::eNormal);
 
-		textures.roughness.loadFromFile(&device, transferQueue, roughnessPath,
-		                                vk::Format::eR8G8B8A8Unorm);
+		textures.roughness.loadCooked(&device, transferQueue, roughnessPath,
+		                              mvk::TextureUsage::eLinear);
 
 		mvk::BaseMaterial::BaseMaterialDescription description{
 			.constants{
@@ -93,13 +110,10 @@ public:
 
 		materials.standard.load(&device, description);
 
-		const std::vector<vk::VertexInputBindingDescription>
-			bindingDescription{
-				mvk::Vertex::getBindingDescription()
-			};
+		const auto bindingDescription = models.ganesh.getBindingDescriptions();
 
-		const auto& attributeDescriptions =
-			mvk::Vertex::getAttributeDescriptions();
+		const auto attributeDescriptions =
+			models.ganesh.getAttributeDescriptions();
 
 		const std::vector<vk::DescriptorSetLayout> descriptorSetLayouts{
 			scene.descriptorSetLayout,
@@ -122,6 +136,7 @@ public:
 			.descriptorSetLayouts = descriptorSetLayouts,
 			.pushConstantRanges = pushConstantRanges,
 			.frontFace = vk::FrontFace::eCounterClockwise,
+			.vertexFormat = models.ganesh.getVertexFormat()
 		};
 
 		pipelines.standard.build(&device, opaquePipelineCreateInfo);
@@ -138,6 +153,11 @@ public:
 		pipelines.standard.release();
 	}
 
+	void onUpdate() override
+	{
+		models.ganesh.updateTransforms(currentFrame);
+	}
+
 	void buildCommandBuffer(const vk::CommandBuffer commandBuffer,
 	                        const vk::Framebuffer framebuffer) override
 	{
@@ -183,53 +203,56 @@ public:
 
 		commandBuffer.setScissor(0, scissor);
 
-		scene.renderSkybox(commandBuffer);
+		scene.renderSkybox(commandBuffer, currentFrame);
 
-		const auto graphicPipeline = pipelines.standard;
-		const auto pipelineLayout = graphicPipeline.getPipelineLayout();
-		const auto pipeline = graphicPipeline.getPipeline();
+		renderQueue.clear();
 
 		for (const auto& node : models.ganesh.nodes)
 		{
-			std::vector<vk::DescriptorSet> descriptorSets = {
-				scene.getDescriptorSet(0),
-				node->getDescriptorSet(),
-				materials.standard.getDescriptorSet()
+			const mvk::DrawPacket packet{
+				.pipeline = &pipelines.standard,
+				.material = &materials.standard,
+				.model = &models.ganesh,
+				.node = &node,
+				.descriptorSets = {
+					scene.getDescriptorSet(currentFrame),
+					models.ganesh.getDescriptorSet(),
+					materials.standard.getDescriptorSet()
+				},
+				.descriptorSetCount = 3,
+				.dynamicSet = 1,
+				.dynamicOffset =
+				models.ganesh.getDynamicOffset(&node, currentFrame),
+				.pushConstants = &materials.standard.constants,
+				.pushConstantsSize = sizeof(mvk::BaseMaterial::PushConstants),
+				.depth = models.ganesh.getViewDepth(&node, scene.camera)
 			};
 
-			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-			                           pipeline);
-
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			                                 pipelineLayout, 0,
-			                                 static_cast<uint32_t>(
-				                                 descriptorSets.size()),
-			                                 descriptorSets.data(), 0, nullptr);
-
-			commandBuffer.pushConstants(pipelineLayout,
-			                            vk::ShaderStageFlagBits::eFragment,
-			                            0, sizeof(mvk::BaseMaterial::
-				                            PushConstants),
-			                            &materials.standard.constants);
-
-			const auto vertexBuffer = models.ganesh.vertexBuffer;
-			const auto indexBuffer = models.ganesh.indexBuffer;
-
-			vk::DeviceSize offsets[] = {0};
-
-			commandBuffer.
-				bindVertexBuffers(0, 1, &vertexBuffer.buffer, offsets);
-
-			commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0,
-			                              vk::IndexType::eUint32);
-
-
-			const auto size = node->indexCount;
-			const auto indexStart = node->startIndex;
-
-			commandBuffer.drawIndexed(size, 1, indexStart, 0, 0);
+			visibleRanges.clear();
+
+			if (meshletCulling && node.meshletCount > 0)
+			{
+				models.ganesh.getVisibleRanges(&node, scene.camera,
+				                               visibleRanges);
+			}
+			else
+			{
+				visibleRanges.push_back(models.ganesh.selectLod(
+					&node, scene.camera, viewport.height, lodPixelError));
+			}
+
+			for (const auto& range : visibleRanges)
+			{
+				auto rangePacket = packet;
+				rangePacket.lod = range;
+
+				renderQueue.push(rangePacket);
+			}
 		}
 
+		renderQueue.sort();
+		renderQueue.execute(commandBuffer);
+
 		commandBuffer.endRenderPass();
 		commandBuffer.end();
 	}
@@ -2,6 +2,7 @@
 #include "Model.h"
 #include "GraphicPipeline.h"
 #include "NormalMaterial.h"
+#include "RenderQueue.h"
 
 class SimpleViewer : public mvk::AppBase
 {
@@ -24,9 +25,13 @@ public:
 	}
 	pipelines;
 
+	mvk::RenderQueue renderQueue;
+
 	SimpleViewer() : AppBase(mvk::AppInfo
 		{
-			.appName = "SimpleViewer"
+			.appName = "SimpleViewer",
+			// Draw order depends on the camera, it is sorted every frame
+			.recordEveryFrame = true
 		})
 	{
 		scene.camera.setPerspective(45.0f, float(width) / float(height),
@@ -83,13 +88,10 @@ public:
 
 		materials.standard.load(&device);
 
-		const std::vector<vk::VertexInputBindingDescription> bindingDescription
-			= {
-				mvk::Vertex::getBindingDescription()
-			};
+		const auto bindingDescription = models.plane.getBindingDescriptions();
 
-		const auto& attributeDescriptions =
-			mvk::Vertex::getAttributeDescriptions();
+		const auto attributeDescriptions =
+			models.plane.getAttributeDescriptions();
 
 		const std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = {
 			scene.descriptorSetLayout,
@@ -119,6 +121,11 @@ public:
 		pipelines.standard.release();
 	}
 
+	void onUpdate() override
+	{
+		models.plane.updateTransforms(currentFrame);
+	}
+
 	void buildCommandBuffer(const vk::CommandBuffer commandBuffer,
 	                        const vk::Framebuffer framebuffer) override
 	{
@@ -146,62 +153,48 @@ public:
 		commandBuffer.beginRenderPass(renderPassBeginInfo,
 		                              vk::SubpassContents::eInline);
 
-		const auto graphicPipeline = pipelines.standard;
-		const auto pipelineLayout = graphicPipeline.getPipelineLayout();
-		const auto pipeline = graphicPipeline.getPipeline();
-
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-		                           pipeline);
-
-		for (const auto& node : models.plane.nodes)
-		{
-			std::vector<vk::DescriptorSet> descriptorSets = {
-				scene.getDescriptorSet(0),
-				node->getDescriptorSet()
-			};
-
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			                                 pipelineLayout, 0,
-			                                 static_cast<uint32_t>(
-				                                 descriptorSets.size()),
-			                                 descriptorSets.data(), 0, nullptr);
-
-			vk::Viewport viewport = {
-				.x = 0.0f,
-				.y = 0.0f,
-				.width = static_cast<float>(extent.width),
-				.height = static_cast<float>(extent.height),
-				.minDepth = 0.0f,
-				.maxDepth = 1.0f
-			};
-
-			commandBuffer.setViewport(0, viewport);
-
-			vk::Rect2D scissor = {
-				.offset = {0, 0},
-				.extent = extent
-			};
-
-			commandBuffer.setScissor(0, scissor);
-
-			const auto vertexBuffer = models.plane.vertexBuffer;
-			const auto indexBuffer = models.plane.indexBuffer;
-
-			vk::DeviceSize offsets[] = {0};
+		const vk::Viewport viewport = {
+			.x = 0.0f,
+			.y = 0.0f,
+			.width = static_cast<float>(extent.width),
+			.height = static_cast<float>(extent.height),
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		};
 
-			commandBuffer.bindVertexBuffers(0, 1,
-			                                &vertexBuffer.buffer,
-			                                offsets);
+		commandBuffer.setViewport(0, viewport);
 
+		const vk::Rect2D scissor = {
+			.offset = {0, 0},
+			.extent = extent
+		};
 
-			commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0,
-			                              vk::IndexType::eUint32);
+		commandBuffer.setScissor(0, scissor);
 
+		renderQueue.clear();
 
-			const auto size = node->indexCount;
-			commandBuffer.drawIndexed(size, 1, 0, 0, 0);
+		for (const auto& node : models.plane.nodes)
+		{
+			renderQueue.push({
+				.pipeline = &pipelines.standard,
+				.material = &materials.standard,
+				.model = &models.plane,
+				.node = &node,
+				.descriptorSets = {
+					scene.getDescriptorSet(currentFrame),
+					models.plane.getDescriptorSet()
+				},
+				.descriptorSetCount = 2,
+				.dynamicSet = 1,
+				.dynamicOffset =
+				models.plane.getDynamicOffset(&node, currentFrame),
+				.depth = models.plane.getViewDepth(&node, scene.camera)
+			});
 		}
 
+		renderQueue.sort();
+		renderQueue.execute(commandBuffer);
+
 		commandBuffer.endRenderPass();
 		commandBuffer.end();
 	}
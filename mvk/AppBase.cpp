@@ -1,23 +1,29 @@
 #include "AppBase.h"
+#include <algorithm>
 #include <set>
 #include <iostream>
 
 using namespace mvk;
 
 AppBase::AppBase(const AppInfo info)
-	: appName(info.appName),
-	  width(info.width),
+	: width(info.width),
 	  height(info.height),
+	  appName(info.appName),
+	  recordEveryFrame(info.recordEveryFrame),
+	  recordingThreads(info.recordingThreads),
 	  startTime(std::chrono::high_resolution_clock::now()),
 	  lastTime(std::chrono::high_resolution_clock::now())
 {
+	// Models track stale frames in 32 bit masks
+	device.framesInFlight = std::clamp(info.framesInFlight, 1u, 32u);
+
 	setupWindow(info.fullscreen);
 	createInstance();
 	createSurfaceKHR();
 	pickPhysicalDevice();
 	createDevice();
 	createQueues();
-	createSemaphores();
+	createFrames(device.framesInFlight);
 	updateSwapchain();
 	createEmptyTexture();
 }
@@ -32,8 +38,10 @@ AppBase::~AppBase()
 	renderPass.release();
 	swapchain.release();
 
-	device.logicalDevice.destroySemaphore(imageAvailableSemaphore);
-	device.logicalDevice.destroySemaphore(renderFinishedSemaphore);
+	for (const auto& frame : frames)
+	{
+		frame.release();
+	}
 
 	device.destroy();
 
@@ -297,25 +305,11 @@ void AppBase::createDevice()
 
 void AppBase::createQueues()
 {
-	if (preferredQueueFamilySetting ==
-		PreferredQueueFamilySettings::eGraphicsTransferTogether)
-	{
-		graphicsQueue = device.logicalDevice.
-		                       getQueue(graphicsQueueFamilyIndex, 0);
-		presentQueue = device.logicalDevice.getQueue(
-			graphicsQueueFamilyIndex, 1);
-		transferQueue = device.logicalDevice.
-		                       getQueue(graphicsQueueFamilyIndex, 2);
-	}
-	else
-	{
-		graphicsQueue = device.logicalDevice.
-		                       getQueue(graphicsQueueFamilyIndex, 0);
-		presentQueue = device.logicalDevice.getQueue(
-			graphicsQueueFamilyIndex, 1);
-		transferQueue = device.logicalDevice.
-		                       getQueue(graphicsQueueFamilyIndex, 0);
-	}
+	graphicsQueue = device.logicalDevice.getQueue(graphicsQueueFamilyIndex, 0);
+	presentQueue = device.logicalDevice.getQueue(graphicsQueueFamilyIndex, 1);
+
+	// A queue of the transfer family when separated
+	transferQueue = device.transferQueue;
 }
 
 void AppBase::waitIdle() const
@@ -325,13 +319,18 @@ void AppBase::waitIdle() const
 
 void AppBase::drawFrame()
 {
+	const auto& frame = frames[currentFrame];
+
+	// Only the frame about to be reused, the others keep rendering
+	frame.wait();
+
 	uint32_t imageIndex;
 	vk::Result result;
 
 	try
 	{
 		result = device.acquireNextImageKHR(swapchain.getSwapchain(),
-		                                    imageAvailableSemaphore,
+		                                    frame.imageAvailableSemaphore,
 		                                    &imageIndex);
 	}
 	catch (vk::OutOfDateKHRError error)
@@ -344,13 +343,25 @@ void AppBase::drawFrame()
 
 	update();
 
-	vk::Semaphore waitSemaphores[]{imageAvailableSemaphore};
+	// Reset once a submission is sure to signal it again
+	frame.resetFence();
+
+	vk::Semaphore waitSemaphores[]{frame.imageAvailableSemaphore};
 	vk::PipelineStageFlags waitStages[]{
 		vk::PipelineStageFlagBits::eColorAttachmentOutput
 	};
-	vk::Semaphore signalSemaphores[]{renderFinishedSemaphore};
+	vk::Semaphore signalSemaphores[]{frame.renderFinishedSemaphore};
 
-	const auto commandBuffer = currentSwapchainFrame.getCommandBuffer();
+	const auto commandBuffer = frame.getCommandBuffer(imageIndex);
+
+	if (recordEveryFrame)
+	{
+		frame.resetCommandPool();
+
+		currentImage = imageIndex;
+		buildCommandBuffer(commandBuffer,
+		                   currentSwapchainFrame.getFramebuffer());
+	}
 
 	const vk::SubmitInfo submitInfo = {
 		.waitSemaphoreCount = 1,
@@ -362,7 +373,9 @@ void AppBase::drawFrame()
 		.pSignalSemaphores = signalSemaphores
 	};
 
-	result = graphicsQueue.submit(1, &submitInfo, nullptr);
+	device.submit(graphicsQueue, submitInfo, frame.getFence());
+
+	currentFrame = (currentFrame + 1) % static_cast<uint32_t>(frames.size());
 
 	vk::SwapchainKHR swapchains[] = {swapchain.getSwapchain()};
 
@@ -376,15 +389,12 @@ void AppBase::drawFrame()
 
 	try
 	{
-		result = graphicsQueue.presentKHR(presentInfo);
+		result = device.present(graphicsQueue, presentInfo);
 	}
 	catch (vk::OutOfDateKHRError error)
 	{
 		updateWindow();
-		return;
 	}
-
-	graphicsQueue.waitIdle();
 }
 
 void AppBase::updateWindow()
@@ -410,6 +420,9 @@ void AppBase::run()
 		drawFrame();
 		glfwPollEvents();
 	}
+
+	// Submitted frames may still be executing
+	device.waitIdle();
 }
 
 void AppBase::updateSwapchain()
@@ -426,7 +439,7 @@ void AppBase::updateSwapchain()
 
 void AppBase::createSwapchain()
 {
-	swapchain.create(&device, transferQueue, surface);
+	swapchain.create(&device, graphicsQueue, surface);
 }
 
 void AppBase::createRenderPass()
@@ -440,7 +453,7 @@ void AppBase::createRenderPass()
 void AppBase::createSwapchainFrames()
 {
 	swapchain.createSwapchainFrames(renderPass.renderPass);
-	swapchain.createCommandBuffers();
+	createFrameCommandBuffers();
 }
 
 void AppBase::createEmptyTexture()
@@ -452,25 +465,92 @@ void AppBase::createEmptyTexture()
 
 void AppBase::buildCommandBuffers()
 {
-	auto frames = swapchain.getSwapchainFrames();
+	// Frames still in flight may be using the command buffers
+	waitIdle();
 
-	for (const auto& frame : frames)
+	const auto swapchainFrames = swapchain.getSwapchainFrames();
+	const auto frameToDraw = currentFrame;
+
+	for (uint32_t f = 0; f < frames.size(); f++)
 	{
-		const auto commandBuffer = frame.getCommandBuffer();
-		const auto framebuffer = frame.getFramebuffer();
+		// The recorded frame's resources, such as its uniform data
+		currentFrame = f;
+
+		for (uint32_t i = 0; i < swapchainFrames.size(); i++)
+		{
+			currentImage = i;
+			buildCommandBuffer(frames[f].getCommandBuffer(i),
+			                   swapchainFrames[i].getFramebuffer());
+		}
+	}
 
-		buildCommandBuffer(commandBuffer, framebuffer);
+	currentFrame = frameToDraw;
+}
+
+void AppBase::recordInParallel(const vk::CommandBuffer commandBuffer,
+                               const vk::Framebuffer framebuffer,
+                               const uint32_t drawCount,
+                               const ParallelRecorder::RecordFunction&
+                               recordDraws)
+{
+	const auto extent = swapchain.getSwapchainExtent();
+
+	const vk::CommandBufferInheritanceInfo inheritanceInfo{
+		.renderPass = renderPass.renderPass,
+		.subpass = 0,
+		.framebuffer = framebuffer
+	};
+
+	const vk::Viewport viewport = {
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = static_cast<float>(extent.width),
+		.height = static_cast<float>(extent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
+
+	const vk::Rect2D scissor = {
+		.offset = {0, 0},
+		.extent = extent
+	};
+
+	frames[currentFrame].getRecorder().record(
+		commandBuffer, currentImage, inheritanceInfo, drawCount,
+		[&](const vk::CommandBuffer secondary, const uint32_t first,
+		    const uint32_t count)
+		{
+			// Secondaries don't inherit dynamic state
+			secondary.setViewport(0, viewport);
+			secondary.setScissor(0, scissor);
+
+			recordDraws(secondary, first, count);
+		});
+}
+
+void AppBase::createFrames(const uint32_t count)
+{
+	const auto threads = recordingThreads == 0
+		                     ? std::thread::hardware_concurrency()
+		                     : recordingThreads;
+
+	frames.resize(count);
+
+	for (auto& frame : frames)
+	{
+		frame.create(&device, threads);
 	}
 }
 
-void AppBase::createSemaphores()
+void AppBase::createFrameCommandBuffers()
 {
-	const vk::SemaphoreCreateInfo semaphoreCreateInfo;
+	const auto imageCount =
+		static_cast<uint32_t>(swapchain.getSwapchainSwainSize());
 
-	imageAvailableSemaphore = device.logicalDevice.createSemaphore(
-		semaphoreCreateInfo);
-	renderFinishedSemaphore = device.logicalDevice.createSemaphore(
-		semaphoreCreateInfo);
+	for (auto& frame : frames)
+	{
+		frame.createCommandBuffers(imageCount);
+	}
 }
 
 void AppBase::update()
@@ -506,11 +586,13 @@ void AppBase::update()
 		scrollY = 0;
 	}
 
-	scene.update(time, deltaTime);
+	scene.update(currentFrame, time, deltaTime);
 
 	lastMouseX = xPos;
 	lastMouseY = yPos;
 	lastTime = currentTime;
+
+	onUpdate();
 }
 
 
@@ -12,6 +12,7 @@
 #include "Scene.h"
 #include "RenderPass.h"
 #include "Texture2D.h"
+#include "FrameInFlight.h"
 #include <chrono>
 
 namespace mvk
@@ -22,6 +23,15 @@ namespace mvk
 		int width = 600;
 		int height = 600;
 		bool fullscreen = false;
+		// Record the frame's command buffer in every drawFrame, for
+		// per frame decisions like LOD selection
+		bool recordEveryFrame = false;
+		// Frames recorded on the CPU while the GPU still renders earlier
+		// ones, each with its own synchronization and uniform data
+		uint32_t framesInFlight = 2;
+		// Workers of AppBase::recordInParallel, 0 for one per hardware
+		// thread
+		uint32_t recordingThreads = 0;
 	};
 
 	class AppBase
@@ -47,8 +57,41 @@ namespace mvk
 		int width;
 		int height;
 
+		// Frame in flight being recorded, selects the per frame resources
+		uint32_t currentFrame = 0;
+
+		// Records the command buffers of every frame in flight and
+		// swapchain image, waits for the device to be idle first
+		virtual void buildCommandBuffers();
+
+		/**
+		 * From buildCommandBuffer, splits drawCount draws across the
+		 * recording threads. Each records its range into a secondary
+		 * command buffer, which starts with the full swapchain viewport and
+		 * scissor, and commandBuffer executes them in order. The render
+		 * pass must have begun with vk::SubpassContents::
+		 * eSecondaryCommandBuffers.
+		 **/
+		void recordInParallel(vk::CommandBuffer commandBuffer,
+		                      vk::Framebuffer framebuffer,
+		                      uint32_t drawCount,
+		                      const ParallelRecorder::RecordFunction&
+		                      recordDraws);
+
+		// Called every frame before its command buffer is recorded and
+		// submitted. The resources of currentFrame are no longer in use,
+		// other frames may still be rendering.
+		virtual void onUpdate()
+		{
+		}
+
 	private:
 		const char* appName;
+		bool recordEveryFrame;
+		uint32_t recordingThreads;
+
+		// Swapchain image of the command buffer being recorded
+		uint32_t currentImage = 0;
 		
 		inline static double lastMouseX = 0;
 		inline static double lastMouseY = 0;
@@ -67,8 +110,7 @@ namespace mvk
 		vk::Instance instance;
 		vk::PhysicalDevice physicalDevice;
 
-		vk::Semaphore imageAvailableSemaphore;
-		vk::Semaphore renderFinishedSemaphore;
+		std::vector<FrameInFlight> frames;
 
 		std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
 		std::chrono::time_point<std::chrono::high_resolution_clock> lastTime;
@@ -95,10 +137,10 @@ namespace mvk
 		void createSwapchainFrames();
 		void updateSwapchain();
 		void createRenderPass();
-		void createSemaphores();
+		void createFrames(uint32_t count);
+		void createFrameCommandBuffers();
 		void createEmptyTexture();
-		
-		virtual void buildCommandBuffers();
+
 		virtual void buildCommandBuffer(vk::CommandBuffer commandBuffer,
 			vk::Framebuffer frameBuffer) = 0;
 
@@ -1,5 +1,8 @@
 #include "CubemapTexture.h"
 #include "../3rdParty/stb_image.h"
+#include <algorithm>
+#include <execution>
+#include <numeric>
 #include <string>
 
 using namespace mvk;
@@ -13,65 +16,78 @@ void CubemapTexture::loadFromSixFiles(Device* device,
 	this->ptrDevice = device;
 	this->format = format;
 
-	const auto nbTextures = 6;
-	vk::DeviceSize imageSize = 0;
-
-	unsigned char* pixels = nullptr;
-
-	for (auto i = 0; i < nbTextures; i++)
+	// Only the header, to size the staging memory before decoding
+	int w, h, c;
+	if (!stbi_info(texturePaths[0].c_str(), &w, &h, &c))
 	{
-		int w, h, c;
-		const auto p = stbi_load(texturePaths[i].c_str(), &w, &h, &c,
-		                         STBI_rgb_alpha);
-		if (i == 0)
-		{
-			width = static_cast<uint32_t>(w);
-			height = static_cast<uint32_t>(h);
-			mipLevels = static_cast<uint32_t>(std::floor(
-				std::log2(std::max(width, height)))) + 1;
-			imageSize = width * height * 4;
-			pixels = new unsigned char[imageSize * nbTextures];
-		}
+		throw std::runtime_error(std::string("Failed to load texture: ") +
+			texturePaths[0]);
+	}
 
-		if (!p)
+	width = static_cast<uint32_t>(w);
+	height = static_cast<uint32_t>(h);
+	mipLevels = static_cast<uint32_t>(std::floor(
+		std::log2(std::max(width, height)))) + 1;
+
+	const vk::DeviceSize faceSize = vk::DeviceSize(width) * height * 4;
+
+	UploadBatch batch(device, transferQueue);
+	const auto staging = batch.allocateStaging(faceSize * 6);
+
+	// Every face is decoded on its own core into its slot of the staging
+	// memory, a face failing to decode or of another size is reported
+	std::array<uint32_t, 6> faces;
+	std::iota(faces.begin(), faces.end(), 0);
+	std::array<bool, 6> decoded{};
+
+	std::for_each(std::execution::par, faces.begin(), faces.end(),
+	              [&](const uint32_t face)
+	              {
+		              int faceWidth, faceHeight, channels;
+		              const auto p = stbi_load(texturePaths[face].c_str(),
+		                                       &faceWidth, &faceHeight,
+		                                       &channels, STBI_rgb_alpha);
+		              if (!p)
+		              {
+			              return;
+		              }
+
+		              if (faceWidth == w && faceHeight == h)
+		              {
+			              memcpy(staging.data + faceSize * face, p,
+			                     static_cast<size_t>(faceSize));
+			              decoded[face] = true;
+		              }
+
+		              stbi_image_free(p);
+	              });
+
+	for (const auto face : faces)
+	{
+		if (!decoded[face])
 		{
-			throw std::
-				runtime_error(std::string("Failed to load texture: ") +
-					texturePaths[i]);
+			throw std::runtime_error(
+				std::string("Failed to load texture: ") +
+				texturePaths[face]);
 		}
-
-		memcpy(&pixels[imageSize * i], p, imageSize);
-
-		stbi_image_free(p);
 	}
 
-	image = copyDataToGpuImage(transferQueue, pixels, width, height, mipLevels,
-	                           format);
+	image = createImage(width, height, mipLevels, format);
+
+	// One copy for the six faces, their mips generated together
+	uploadLayers(batch, image.image, staging, 6);
+	batch.flush();
 
 	createImageView();
 	createSampler();
 	createDescriptorInfo();
 }
 
-alloc::Image CubemapTexture::copyDataToGpuImage(
-	const vk::Queue transferQueue,
-	const unsigned char* pixels,
-	const uint32_t width,
-	const uint32_t height,
-	const uint32_t mipLevels,
-	const vk::Format format)
+alloc::Image CubemapTexture::createImage(const uint32_t width,
+                                         const uint32_t height,
+                                         const uint32_t mipLevels,
+                                         const vk::Format format) const
 {
-	const vk::DeviceSize imageSize = width * height * 4 * 6;
-	const vk::BufferCreateInfo bufferCreateInfo{
-		.size = imageSize,
-		.usage = vk::BufferUsageFlagBits::eTransferSrc
-	};
-
-	const auto stagingBuffer =
-		alloc::allocateMappedCpuToGpuBuffer(ptrDevice->allocator,
-		                                    bufferCreateInfo,
-		                                    pixels);
-
 	const vk::Extent3D imageExtent{
 		.width = width,
 		.height = height,
@@ -94,57 +110,22 @@ alloc::Image CubemapTexture::copyDataToGpuImage(
 		.initialLayout = vk::ImageLayout::eUndefined,
 	};
 
-	const auto imageBuffer = alloc::allocateGpuOnlyImage(ptrDevice->allocator,
-	                                                     imageCreateInfo);
-
-	vk::BufferImageCopy bufferImageCopy{
-		.bufferOffset = 0,
-		.bufferRowLength = width,
-		.bufferImageHeight = height,
-		.imageSubresource = {
-			.aspectMask = vk::ImageAspectFlagBits::eColor,
-			.mipLevel = 0,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
-		},
-		.imageOffset = {0, 0},
-		.imageExtent = imageExtent,
-	};
-
-	const vk::ImageSubresourceRange subresourceRange{
-		.baseMipLevel = 0,
-		.levelCount = mipLevels,
-		.baseArrayLayer = 0,
-		.layerCount = 6
-	};
-
-	ptrDevice->transitionImageLayout(transferQueue, imageBuffer.image,
-		vk::ImageLayout::eUndefined,
-		vk::ImageLayout::eTransferDstOptimal,
-		subresourceRange);
-
-	for (uint32_t i = 0; i < 6; i++)
-	{
-		bufferImageCopy.imageSubresource.baseArrayLayer = i;
-		bufferImageCopy.bufferOffset = i * width * height * 4;
-
-		ptrDevice->copyCpuBufferToGpuImage(transferQueue, stagingBuffer,
-		                                   imageBuffer,
-		                                   bufferImageCopy);
-
-		if (mipLevels > 1)
-		{
-			generateMipMaps(transferQueue, imageBuffer.image, i);
-		}
-	}
+	return alloc::allocateGpuOnlyImage(ptrDevice->allocator,
+	                                   imageCreateInfo);
+}
 
-	ptrDevice->transitionImageLayout(transferQueue, imageBuffer.image,
-		vk::ImageLayout::eTransferDstOptimal,
-		vk::ImageLayout::
-		eShaderReadOnlyOptimal,
-		subresourceRange);
+alloc::Image CubemapTexture::copyDataToGpuImage(
+	const vk::Queue transferQueue,
+	const unsigned char* pixels,
+	const uint32_t width,
+	const uint32_t height,
+	const uint32_t mipLevels,
+	const vk::Format format)
+{
+	const auto imageBuffer = createImage(width, height, mipLevels, format);
 
-	alloc::deallocateBuffer(ptrDevice->allocator, stagingBuffer);
+	// One copy for the six faces, their mips generated together
+	uploadLayers(transferQueue, imageBuffer.image, pixels, 6);
 
 	return imageBuffer;
 }
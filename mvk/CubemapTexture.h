@@ -6,6 +6,9 @@ namespace mvk
 {
 	class CubemapTexture : public Texture
 	{
+		alloc::Image createImage(uint32_t width, uint32_t height,
+		                         uint32_t mipLevels, vk::Format format) const;
+
 		alloc::Image copyDataToGpuImage(vk::Queue transferQueue,
 		                                const unsigned char* pixels,
 		                                uint32_t width,
@@ -21,6 +24,7 @@ namespace mvk
 
 		vk::DescriptorImageInfo descriptorInfo;
 
+		// The faces are decoded in parallel, they must share one size
 		void loadFromSixFiles(Device* device,
 		                      vk::Queue transferQueue,
 		                      std::array<std::string, 6> texturePaths,
@@ -1,21 +1,87 @@
 #pragma once
 
 #include "VulkanVma.h"
+#include "StagingRing.h"
+#include "UniformRing.h"
 #include "Utils.hpp"
 
+#include <map>
+#include <mutex>
+#include <span>
+#include <thread>
+
 namespace mvk
 {
 	class Device
 	{
+		// One time commands may be recorded by loader threads, every thread
+		// records into pools of its own, one per queue family
+		mutable std::mutex oneTimeCommandPoolsMutex;
+		mutable std::map<std::pair<std::thread::id, uint32_t>,
+		                 vk::CommandPool> oneTimeCommandPools;
+
+		// Queues are externally synchronized
+		mutable std::mutex submitMutex;
+
+		vk::CommandPool getOneTimeCommandPool(
+			const uint32_t queueFamilyIndex) const
+		{
+			std::lock_guard lock(oneTimeCommandPoolsMutex);
+
+			auto& pool = oneTimeCommandPools[{
+				std::this_thread::get_id(), queueFamilyIndex
+			}];
+
+			if (!pool)
+			{
+				const vk::CommandPoolCreateInfo commandPoolCreateInfo = {
+					.flags = vk::CommandPoolCreateFlagBits::eTransient,
+					.queueFamilyIndex = queueFamilyIndex
+				};
+
+				pool = logicalDevice.createCommandPool(commandPoolCreateInfo);
+			}
+
+			return pool;
+		}
+
+		void freeOneTimeSubmitCommands(const vk::CommandBuffer commandBuffer,
+		                               const uint32_t queueFamilyIndex) const
+		{
+			logicalDevice.freeCommandBuffers(
+				getOneTimeCommandPool(queueFamilyIndex), 1, &commandBuffer);
+		}
+
 	public:
 		vk::Device logicalDevice;
 		vma::Allocator allocator;
 		vk::PhysicalDevice physicalDevice;
 		vk::CommandPool commandPool;
 		uint32_t graphicsQueueFamilyIndex;
+		// Same as graphicsQueueFamilyIndex unless the transfer family is
+		// separated
+		uint32_t transferQueueFamilyIndex;
+
+		vk::Queue transferQueue;
+		// Graphics family queue running the graphics half of uploads, such
+		// as mip blits, and taking ownership of what a separated transfer
+		// family uploaded. The transfer queue itself when not separated.
+		vk::Queue acquireQueue;
+
+		// Staging memory of UploadBatch
+		StagingRing stagingRing;
+		static constexpr vk::DeviceSize stagingRingSize = 64 << 20;
+
+		// Per frame uniform data of scenes, skyboxes and model nodes
+		UniformRing uniformRing;
+		static constexpr vk::DeviceSize uniformRingFrameSize = 4 << 20;
 
 		vk::SampleCountFlagBits multiSampling;
 
+		// Frames the CPU may record while the GPU renders earlier ones,
+		// per frame resources are created this many times
+		uint32_t framesInFlight = 1;
+
 		void filterDeviceExtensions(std::vector<const char*>& extensions) const
 		{
 			auto availableLayers = physicalDevice.
@@ -134,6 +200,11 @@ namespace mvk
 		{
 			this->physicalDevice = physicalDevice;
 			this->graphicsQueueFamilyIndex = graphicsQueueFamilyIndex;
+			this->transferQueueFamilyIndex =
+				preferredQueueFamilySetting ==
+				PreferredQueueFamilySettings::eGraphicTransferSeparated
+					? transferQueueFamilyIndex
+					: graphicsQueueFamilyIndex;
 
 			std::vector<vk::DeviceQueueCreateInfo> deviceQueues;
 
@@ -155,12 +226,14 @@ namespace mvk
 			}
 			else
 			{
-				const std::array<const float, 2> queuePriority = {0.0f, 0.0f};
+				const std::array<const float, 3> queuePriority = {
+					0.0f, 0.0f, 0.0f
+				};
 
 				const vk::DeviceQueueCreateInfo deviceGraphicQueueCreateInfo
 				{
 					.queueFamilyIndex = graphicsQueueFamilyIndex,
-					.queueCount = 2,
+					.queueCount = 3,
 					.pQueuePriorities = queuePriority.data()
 				};
 
@@ -212,7 +285,21 @@ namespace mvk
 
 			logicalDevice = physicalDevice.createDevice(deviceCreateInfo);
 
+			// Graphics family queues 0 and 1 render and present
+			acquireQueue = logicalDevice.getQueue(graphicsQueueFamilyIndex, 2);
+			transferQueue = hasSeparatedTransferQueue()
+				                ? logicalDevice.getQueue(
+					                this->transferQueueFamilyIndex, 0)
+				                : acquireQueue;
+
 			allocator = alloc::init(physicalDevice, logicalDevice, instance);
+			stagingRing.create(allocator, stagingRingSize);
+
+			// Frame count is set by the application before the device
+			uniformRing.create(allocator, uniformRingFrameSize,
+			                   physicalDevice.getProperties().limits.
+			                                  minUniformBufferOffsetAlignment,
+			                   framesInFlight);
 
 #if (NDEBUG)
 			std::cout << "Logical device created!" << std::endl;
@@ -225,7 +312,9 @@ namespace mvk
 
 		void createCommandPool()
 		{
+			// Command buffers may be recorded again every frame
 			const vk::CommandPoolCreateInfo commandPoolCreateInfo = {
+				.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
 				.queueFamilyIndex = graphicsQueueFamilyIndex
 			};
 
@@ -262,9 +351,30 @@ namespace mvk
 			logicalDevice.freeCommandBuffers(commandPool, 1, &commandBuffer);
 		}
 
-		vk::CommandBuffer beginOneTimeSubmitCommands() const
+		bool hasSeparatedTransferQueue() const
+		{
+			return transferQueueFamilyIndex != graphicsQueueFamilyIndex;
+		}
+
+		uint32_t getQueueFamilyIndex(const vk::Queue queue) const
+		{
+			return queue == transferQueue
+				       ? transferQueueFamilyIndex
+				       : graphicsQueueFamilyIndex;
+		}
+
+		// Records commands to be submitted to queue
+		vk::CommandBuffer beginOneTimeSubmitCommands(const vk::Queue queue)
+		const
 		{
-			const auto commandBuffer = createCommandBuffer();
+			const vk::CommandBufferAllocateInfo commandBufferAllocateInfo = {
+				.commandPool = getOneTimeCommandPool(
+					getQueueFamilyIndex(queue)),
+				.commandBufferCount = 1
+			};
+
+			const auto commandBuffer = logicalDevice.allocateCommandBuffers(
+				commandBufferAllocateInfo).front();
 
 			const vk::CommandBufferBeginInfo bufferBeginInfo = {
 				.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
@@ -285,53 +395,116 @@ namespace mvk
 				.pCommandBuffers = &commandBuffer
 			};
 
-			const auto result = queue.submit(1, &submitInfo, nullptr);
-			queue.waitIdle();
+			// Wait on a fence rather than on the queue, so that threads
+			// sharing a queue only serialize their submissions
+			const auto fence = logicalDevice.createFence({});
 
-			freeCommandBuffer(commandBuffer);
+			{
+				std::lock_guard lock(submitMutex);
+				queue.submit(submitInfo, fence);
+			}
+
+			const auto result = logicalDevice.waitForFences(
+				1, &fence, VK_TRUE, UINT64_MAX);
+
+			logicalDevice.destroyFence(fence);
+			freeOneTimeSubmitCommands(commandBuffer,
+			                          getQueueFamilyIndex(queue));
+
+			if (result != vk::Result::eSuccess)
+			{
+				throw std::runtime_error("Failed to wait for an upload");
+			}
 		}
 
-		void copyCpuToGpuBuffer(const vk::Queue transferQueue,
-		                        const alloc::Buffer src,
-		                        const alloc::Buffer dst,
-		                        const vk::DeviceSize size) const
+		/**
+		 * Submits transferCommands to the transfer queue, then
+		 * graphicsCommands to the acquire queue once a semaphore tells the
+		 * transfer is done, and waits for both.
+		 **/
+		void endOneTimeSubmitCommands(
+			const vk::CommandBuffer transferCommands,
+			const std::span<const vk::CommandBuffer> graphicsCommands) const
 		{
-			const auto commandBuffer = beginOneTimeSubmitCommands();
+			transferCommands.end();
+
+			for (const auto commandBuffer : graphicsCommands)
+			{
+				commandBuffer.end();
+			}
 
-			const vk::BufferCopy bufferCopy = {
-				.size = size
+			const auto semaphore = logicalDevice.createSemaphore({});
+			const auto fence = logicalDevice.createFence({});
+
+			const vk::SubmitInfo transferSubmitInfo = {
+				.commandBufferCount = 1,
+				.pCommandBuffers = &transferCommands,
+				.signalSemaphoreCount = 1,
+				.pSignalSemaphores = &semaphore
 			};
 
-			commandBuffer.copyBuffer(src.buffer, dst.buffer, 1, &bufferCopy);
+			const vk::PipelineStageFlags waitStage =
+				vk::PipelineStageFlagBits::eAllCommands;
 
-			endOneTimeSubmitCommands(commandBuffer, transferQueue);
-		}
+			const vk::SubmitInfo graphicsSubmitInfo = {
+				.waitSemaphoreCount = 1,
+				.pWaitSemaphores = &semaphore,
+				.pWaitDstStageMask = &waitStage,
+				.commandBufferCount = static_cast<uint32_t>(
+					graphicsCommands.size()),
+				.pCommandBuffers = graphicsCommands.data()
+			};
 
-		void copyCpuBufferToGpuImage(const vk::Queue transferQueue,
-		                             const alloc::Buffer src,
-		                             const alloc::Image dst,
-		                             const vk::BufferImageCopy bufferImageCopy)
-		const
-		{
-			const auto commandBuffer = beginOneTimeSubmitCommands();
+			{
+				std::lock_guard lock(submitMutex);
+				transferQueue.submit(transferSubmitInfo, nullptr);
+				acquireQueue.submit(graphicsSubmitInfo, fence);
+			}
+
+			// The graphics submission waited for the transfer one
+			const auto result = logicalDevice.waitForFences(
+				1, &fence, VK_TRUE, UINT64_MAX);
 
-			commandBuffer.copyBufferToImage(src.buffer, dst.image,
-			                                vk::ImageLayout::
-			                                eTransferDstOptimal,
-			                                1, &bufferImageCopy);
+			logicalDevice.destroyFence(fence);
+			logicalDevice.destroySemaphore(semaphore);
 
-			endOneTimeSubmitCommands(commandBuffer, transferQueue);
+			freeOneTimeSubmitCommands(transferCommands,
+			                          transferQueueFamilyIndex);
+
+			for (const auto commandBuffer : graphicsCommands)
+			{
+				freeOneTimeSubmitCommands(commandBuffer,
+				                          graphicsQueueFamilyIndex);
+			}
+
+			if (result != vk::Result::eSuccess)
+			{
+				throw std::runtime_error("Failed to wait for an upload");
+			}
 		}
 
 		void transitionImageLayout(
-			const vk::Queue transferQueue,
+			const vk::Queue queue,
 			const vk::Image image,
 			const vk::ImageLayout oldLayout,
 			const vk::ImageLayout newLayout,
 			const vk::ImageSubresourceRange subresourceRange) const
 		{
-			const auto commandBuffer = beginOneTimeSubmitCommands();
+			const auto commandBuffer = beginOneTimeSubmitCommands(queue);
+
+			recordImageLayoutTransition(commandBuffer, image, oldLayout,
+			                            newLayout, subresourceRange);
+
+			endOneTimeSubmitCommands(commandBuffer, queue);
+		}
 
+		static void recordImageLayoutTransition(
+			const vk::CommandBuffer commandBuffer,
+			const vk::Image image,
+			const vk::ImageLayout oldLayout,
+			const vk::ImageLayout newLayout,
+			const vk::ImageSubresourceRange subresourceRange)
+		{
 			vk::ImageMemoryBarrier imageMemoryBarrier = {
 				.oldLayout = oldLayout,
 				.newLayout = newLayout,
@@ -416,29 +589,31 @@ namespace mvk
 			                              0, nullptr,
 			                              0, nullptr,
 			                              1, &imageMemoryBarrier);
+		}
 
-			endOneTimeSubmitCommands(commandBuffer, transferQueue);
+		/**
+		 * Frame submits and presents go through here, so that they never
+		 * race a one time submit on a queue another thread resolved to the
+		 * same VkQueue.
+		 **/
+		void submit(const vk::Queue queue, const vk::SubmitInfo& submitInfo,
+		            const vk::Fence fence) const
+		{
+			std::lock_guard lock(submitMutex);
+			queue.submit(submitInfo, fence);
 		}
 
-		alloc::Buffer transferDataSetToGpuBuffer(
-			const vk::Queue transferQueue,
-			void* data,
-			const vk::DeviceSize size,
-			const vk::BufferUsageFlagBits usageFlag) const
+		vk::Result present(const vk::Queue queue,
+		                   const vk::PresentInfoKHR& presentInfo) const
 		{
-			const auto stagingVertexBuffer =
-				alloc::allocateStagingTransferBuffer(allocator, data, size);
-			const auto indexBuffer = alloc::createGpuBufferDst(allocator, size,
-			                                                   usageFlag);
-			copyCpuToGpuBuffer(transferQueue, stagingVertexBuffer, indexBuffer,
-			                   size);
-			alloc::deallocateBuffer(allocator, stagingVertexBuffer);
-
-			return indexBuffer;
+			std::lock_guard lock(submitMutex);
+			return queue.presentKHR(presentInfo);
 		}
 
 		void waitIdle() const
 		{
+			// Also waits for the uploads of loader threads
+			std::lock_guard lock(submitMutex);
 			logicalDevice.waitIdle();
 		}
 
@@ -454,7 +629,14 @@ namespace mvk
 
 		void destroy() const
 		{
+			for (const auto& [key, pool] : oneTimeCommandPools)
+			{
+				logicalDevice.destroyCommandPool(pool);
+			}
+
 			logicalDevice.destroyCommandPool(commandPool);
+			stagingRing.destroy(allocator);
+			uniformRing.destroy();
 			allocator.destroy();
 			logicalDevice.destroy();
 		}
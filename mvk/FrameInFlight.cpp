@@ -0,0 +1,117 @@
+#include "FrameInFlight.h"
+
+using namespace mvk;
+
+void FrameInFlight::create(Device* device, const uint32_t recordingThreads)
+{
+	this->ptrDevice = device;
+	this->recordingThreads = recordingThreads;
+
+	// Prerecorded command buffers are recorded again on swapchain changes
+	const vk::CommandPoolCreateInfo commandPoolCreateInfo = {
+		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		.queueFamilyIndex = device->graphicsQueueFamilyIndex
+	};
+
+	commandPool =
+		device->logicalDevice.createCommandPool(commandPoolCreateInfo);
+
+	const vk::SemaphoreCreateInfo semaphoreCreateInfo;
+
+	imageAvailableSemaphore =
+		device->logicalDevice.createSemaphore(semaphoreCreateInfo);
+	renderFinishedSemaphore =
+		device->logicalDevice.createSemaphore(semaphoreCreateInfo);
+
+	// Signaled, the first wait returns at once
+	const vk::FenceCreateInfo fenceCreateInfo{
+		.flags = vk::FenceCreateFlagBits::eSignaled
+	};
+
+	fence = device->logicalDevice.createFence(fenceCreateInfo);
+}
+
+void FrameInFlight::release() const
+{
+	if (ptrDevice == nullptr)
+	{
+		return;
+	}
+
+	const auto logicalDevice = ptrDevice->logicalDevice;
+
+	logicalDevice.destroyFence(fence);
+	logicalDevice.destroySemaphore(imageAvailableSemaphore);
+	logicalDevice.destroySemaphore(renderFinishedSemaphore);
+
+	// Frees the command buffers with it
+	logicalDevice.destroyCommandPool(commandPool);
+
+	recorder.release();
+}
+
+void FrameInFlight::createCommandBuffers(const uint32_t count)
+{
+	if (!commandBuffers.empty())
+	{
+		ptrDevice->logicalDevice.freeCommandBuffers(commandPool,
+		                                            commandBuffers);
+	}
+
+	const vk::CommandBufferAllocateInfo commandBufferAllocateInfo{
+		.commandPool = commandPool,
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = count
+	};
+
+	commandBuffers = ptrDevice->logicalDevice.allocateCommandBuffers(
+		commandBufferAllocateInfo);
+
+	if (recorder.isCreated())
+	{
+		recorder.createCommandBuffers(count);
+	}
+}
+
+ParallelRecorder& FrameInFlight::getRecorder()
+{
+	if (!recorder.isCreated())
+	{
+		recorder.create(ptrDevice, recordingThreads);
+		recorder.createCommandBuffers(
+			static_cast<uint32_t>(commandBuffers.size()));
+	}
+
+	return recorder;
+}
+
+void FrameInFlight::wait() const
+{
+	const auto result = ptrDevice->logicalDevice.waitForFences(
+		1, &fence, VK_TRUE, UINT64_MAX);
+
+	if (result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Failed to wait for the frame fence");
+	}
+}
+
+void FrameInFlight::resetFence() const
+{
+	const auto result = ptrDevice->logicalDevice.resetFences(1, &fence);
+
+	if (result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Failed to reset the frame fence");
+	}
+}
+
+void FrameInFlight::resetCommandPool() const
+{
+	ptrDevice->logicalDevice.resetCommandPool(commandPool, {});
+
+	if (recorder.isCreated())
+	{
+		recorder.resetCommandPools();
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Device.hpp"
+#include "ParallelRecorder.h"
+
+namespace mvk
+{
+	/**
+	 * What one frame in flight owns: the semaphores ordering its acquire,
+	 * render and present, the fence the CPU waits on before reusing it, a
+	 * command pool holding a primary command buffer per swapchain image,
+	 * and the worker pools of the secondaries those primaries execute.
+	 * Worker pools are only created when a frame first records in
+	 * parallel.
+	 **/
+	class FrameInFlight
+	{
+		Device* ptrDevice = nullptr;
+
+		vk::CommandPool commandPool;
+		std::vector<vk::CommandBuffer> commandBuffers;
+
+		vk::Fence fence;
+
+		uint32_t recordingThreads = 0;
+		ParallelRecorder recorder;
+
+	public:
+
+		vk::Semaphore imageAvailableSemaphore;
+		vk::Semaphore renderFinishedSemaphore;
+
+		void create(Device* device, uint32_t recordingThreads);
+		void release() const;
+
+		// Frees the previous command buffers, the frame must be idle
+		void createCommandBuffers(uint32_t count);
+
+		vk::CommandBuffer getCommandBuffer(const uint32_t imageIndex) const
+		{
+			return commandBuffers[imageIndex];
+		}
+
+		vk::Fence getFence() const { return fence; }
+
+		// Created on first use, with a secondary per command buffer
+		ParallelRecorder& getRecorder();
+
+		// Until the last submission of this frame is complete
+		void wait() const;
+		void resetFence() const;
+
+		// The frame must be idle
+		void resetCommandPool() const;
+	};
+}
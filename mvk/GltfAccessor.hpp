@@ -0,0 +1,199 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+#include "../3rdParty/tiny_gltf.h"
+
+namespace mvk
+{
+	/**
+	 * Typed read-only view over a glTF accessor. It points straight into the
+	 * parsed buffer, nothing is copied. Every component type, normalized
+	 * integers and interleaved buffer views (byteStride) are handled.
+	 * An accessor without buffer view reads as zeros, as the spec requires.
+	 **/
+	class GltfAccessorView
+	{
+		const unsigned char* data = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+		size_t componentSize = 0;
+		int componentType = -1;
+		int componentCount = 0;
+		bool normalized = false;
+
+		template <typename T>
+		static T load(const unsigned char* ptr)
+		{
+			// Buffer views are not guaranteed to be aligned for T
+			T value;
+			memcpy(&value, ptr, sizeof(T));
+			return value;
+		}
+
+		float readComponent(const unsigned char* ptr) const
+		{
+			switch (componentType)
+			{
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:
+				return load<float>(ptr);
+			case TINYGLTF_COMPONENT_TYPE_DOUBLE:
+				return static_cast<float>(load<double>(ptr));
+			case TINYGLTF_COMPONENT_TYPE_BYTE:
+				{
+					const auto value = static_cast<float>(load<int8_t>(ptr));
+					return normalized
+						       ? std::max(value / 127.0f, -1.0f)
+						       : value;
+				}
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				{
+					const auto value = static_cast<float>(load<uint8_t>(ptr));
+					return normalized ? value / 255.0f : value;
+				}
+			case TINYGLTF_COMPONENT_TYPE_SHORT:
+				{
+					const auto value = static_cast<float>(load<int16_t>(ptr));
+					return normalized
+						       ? std::max(value / 32767.0f, -1.0f)
+						       : value;
+				}
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				{
+					const auto value = static_cast<float>(load<uint16_t>(ptr));
+					return normalized ? value / 65535.0f : value;
+				}
+			case TINYGLTF_COMPONENT_TYPE_INT:
+				return static_cast<float>(load<int32_t>(ptr));
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+				return static_cast<float>(load<uint32_t>(ptr));
+			default:
+				return 0.0f;
+			}
+		}
+
+	public:
+
+		GltfAccessorView() = default;
+
+		// glbBinary replaces the first buffer when it has no uri, so that
+		// a mapped GLB binary chunk is read in place
+		GltfAccessorView(const tinygltf::Model& model, const int accessorIndex,
+		                 const std::span<const unsigned char> glbBinary = {})
+		{
+			const auto& accessor = model.accessors.at(accessorIndex);
+
+			count = accessor.count;
+			normalized = accessor.normalized;
+			componentType = accessor.componentType;
+			componentCount = tinygltf::GetNumComponentsInType(
+				static_cast<uint32_t>(accessor.type));
+			componentSize = tinygltf::GetComponentSizeInBytes(
+				static_cast<uint32_t>(accessor.componentType));
+
+			if (accessor.bufferView < 0)
+			{
+				return;
+			}
+
+			const auto& bufferView = model.bufferViews.at(accessor.bufferView);
+			const auto& buffer = model.buffers.at(bufferView.buffer);
+
+			const auto bytes =
+				bufferView.buffer == 0 && buffer.uri.empty() &&
+				!glbBinary.empty()
+					? glbBinary
+					: std::span<const unsigned char>(buffer.data);
+
+			const auto byteStride = accessor.ByteStride(bufferView);
+
+			if (byteStride <= 0)
+			{
+				throw std::runtime_error("Invalid glTF accessor stride");
+			}
+
+			stride = static_cast<size_t>(byteStride);
+
+			const auto elementSize = componentSize * componentCount;
+
+			// An interleaved element must not run into the next one
+			if (bufferView.byteStride > 0 &&
+				accessor.byteOffset + elementSize > bufferView.byteStride)
+			{
+				throw std::runtime_error("glTF accessor exceeds its stride");
+			}
+
+			if (bufferView.byteOffset > bytes.size() ||
+				bufferView.byteLength > bytes.size() - bufferView.byteOffset)
+			{
+				throw std::runtime_error("glTF buffer view out of range");
+			}
+
+			// Elements must stay inside the view, not only the buffer
+			if (count > 0 &&
+				accessor.byteOffset + stride * (count - 1) + elementSize >
+				bufferView.byteLength)
+			{
+				throw std::runtime_error("glTF accessor out of view range");
+			}
+
+			data = bytes.data() + bufferView.byteOffset + accessor.byteOffset;
+		}
+
+		size_t size() const { return count; }
+
+		bool isIndexType() const
+		{
+			return componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT ||
+				componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ||
+				componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		}
+
+		template <int N>
+		glm::vec<N, float> read(const size_t index) const
+		{
+			glm::vec<N, float> value(0.0f);
+
+			if (!data)
+			{
+				return value;
+			}
+
+			const auto element = data + index * stride;
+			const auto components = std::min(N, componentCount);
+
+			for (auto c = 0; c < components; c++)
+			{
+				value[c] = readComponent(element + c * componentSize);
+			}
+
+			return value;
+		}
+
+		uint32_t readIndex(const size_t index) const
+		{
+			if (!data)
+			{
+				return 0;
+			}
+
+			const auto element = data + index * stride;
+
+			switch (componentType)
+			{
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+				return load<uint32_t>(element);
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				return load<uint16_t>(element);
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				return load<uint8_t>(element);
+			default:
+				// Rejected up front, see isIndexType()
+				return 0;
+			}
+		}
+	};
+}
@@ -137,11 +137,38 @@ void GraphicPipeline::build(Device* device,
 	pipelineLayout =
 		device->logicalDevice.createPipelineLayout(pipelineLayoutCreateInfo);
 
+	/** Vertex format, specialization constant 0 of the vertex stage **/
+	const vk::Bool32 packedVertices =
+		createInfo.vertexFormat == VertexFormat::ePacked;
+
+	const vk::SpecializationMapEntry specializationMapEntry{
+		.constantID = 0,
+		.offset = 0,
+		.size = sizeof packedVertices
+	};
+
+	const vk::SpecializationInfo specializationInfo{
+		.mapEntryCount = 1,
+		.pMapEntries = &specializationMapEntry,
+		.dataSize = sizeof packedVertices,
+		.pData = &packedVertices
+	};
+
+	auto shaderStageCreateInfos = createInfo.shaderStageCreateInfos;
+
+	for (auto& shaderStageCreateInfo : shaderStageCreateInfos)
+	{
+		if (shaderStageCreateInfo.stage == vk::ShaderStageFlagBits::eVertex
+			&& !shaderStageCreateInfo.pSpecializationInfo)
+		{
+			shaderStageCreateInfo.pSpecializationInfo = &specializationInfo;
+		}
+	}
+
 	const vk::PipelineCache pipelineCache;
 	const vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo{
-		.stageCount =
-		static_cast<uint32_t>(createInfo.shaderStageCreateInfos.size()),
-		.pStages = createInfo.shaderStageCreateInfos.data(),
+		.stageCount = static_cast<uint32_t>(shaderStageCreateInfos.size()),
+		.pStages = shaderStageCreateInfos.data(),
 		.pVertexInputState = &pipelineVertexInputStateCreateInfo,
 		.pInputAssemblyState = &pipelineInputAssemblyStateCreateInfo,
 		.pViewportState = &pipelineViewportStateCreateInfo,
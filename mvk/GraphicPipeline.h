@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Device.hpp"
+#include "Vertex.h"
 
 namespace mvk
 {
@@ -18,6 +19,9 @@ namespace mvk
 		vk::CullModeFlagBits cullMode = vk::CullModeFlagBits::eBack;
 		vk::Bool32 alpha = vk::Bool32(false);
 		vk::Bool32 depthTest = vk::Bool32(true);
+		// Must match the vertex input descriptions, shaders read it as
+		// specialization constant 0
+		VertexFormat vertexFormat = VertexFormat::eFull;
 	};
 
 	class GraphicPipeline
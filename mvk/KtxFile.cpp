@@ -0,0 +1,131 @@
+#include "KtxFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+using namespace mvk;
+
+namespace
+{
+	constexpr unsigned char ktx2Identifier[12] = {
+		0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+	};
+
+	struct Header
+	{
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		// Supercompression global data range follows, unused
+	};
+
+	// Level index, after the identifier, the header and the sgd range
+	constexpr size_t levelIndexOffset = 80;
+
+	static_assert(sizeof ktx2Identifier + sizeof(Header) + 16
+		== levelIndexOffset);
+
+	struct LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+}
+
+bool KtxFile::isKtx2(const std::span<const unsigned char> data)
+{
+	return data.size() >= sizeof ktx2Identifier
+		&& memcmp(data.data(), ktx2Identifier, sizeof ktx2Identifier) == 0;
+}
+
+KtxFile::KtxFile(const std::span<const unsigned char> data) : file(data)
+{
+	if (!isKtx2(data) || data.size() < levelIndexOffset)
+	{
+		throw std::runtime_error("Invalid KTX2 file");
+	}
+
+	Header header;
+	memcpy(&header, data.data() + sizeof ktx2Identifier, sizeof header);
+
+	if (header.supercompressionScheme != 0)
+	{
+		throw std::runtime_error(
+			"Supercompressed KTX2 files are not supported");
+	}
+
+	if (header.vkFormat == 0)
+	{
+		throw std::runtime_error("KTX2 file without Vulkan format");
+	}
+
+	if (header.pixelDepth > 1 || header.layerCount > 1
+		|| header.faceCount != 1 || header.pixelHeight == 0)
+	{
+		throw std::runtime_error("Only 2D KTX2 images are supported");
+	}
+
+	if (header.pixelWidth == 0)
+	{
+		throw std::runtime_error("KTX2 file with zero width");
+	}
+
+	// floor(log2(max(width, height))) + 1 levels make a full mip chain
+	const auto maxLevelCount = static_cast<uint32_t>(std::bit_width(
+		std::max(header.pixelWidth, header.pixelHeight)));
+
+	if (header.levelCount > maxLevelCount)
+	{
+		throw std::runtime_error("KTX2 file with too many levels");
+	}
+
+	format = static_cast<vk::Format>(header.vkFormat);
+	width = header.pixelWidth;
+	height = header.pixelHeight;
+
+	// No level means the mip chain is left to the loader, only the base
+	// level is used then
+	const auto levelCount = std::max(header.levelCount, 1u);
+
+	if (data.size() < levelIndexOffset + levelCount * sizeof(LevelIndex))
+	{
+		throw std::runtime_error("Truncated KTX2 level index");
+	}
+
+	levels.reserve(levelCount);
+
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		LevelIndex level;
+		memcpy(&level,
+		       data.data() + levelIndexOffset + i * sizeof(LevelIndex),
+		       sizeof level);
+
+		if (level.byteLength == 0 || level.byteOffset > data.size()
+			|| level.byteLength > data.size() - level.byteOffset)
+		{
+			throw std::runtime_error("KTX2 level out of file range");
+		}
+
+		levels.push_back({
+			.offset = level.byteOffset,
+			.size = level.byteLength,
+			.width = std::max(width >> i, 1u),
+			.height = std::max(height >> i, 1u)
+		});
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Vulkan.h"
+
+#include <span>
+#include <vector>
+
+namespace mvk
+{
+	// Mip level of a KTX2 file, offset is from the start of the file
+	struct KtxLevel
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	/**
+	 * View over a KTX2 file held in memory, level 0 first. Only single 2D
+	 * images stored in a Vulkan format are accepted. Supercompressed files
+	 * (Basis Universal, Zstandard) need a transcoder, they are rejected.
+	 **/
+	class KtxFile
+	{
+		std::span<const unsigned char> file;
+
+		vk::Format format = vk::Format::eUndefined;
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		std::vector<KtxLevel> levels;
+
+	public:
+
+		static bool isKtx2(std::span<const unsigned char> data);
+
+		// Throws when the file is invalid or not supported
+		explicit KtxFile(std::span<const unsigned char> data);
+
+		vk::Format getFormat() const { return format; }
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+
+		std::span<const KtxLevel> getLevels() const { return levels; }
+
+		std::span<const unsigned char> getData() const { return file; }
+	};
+}
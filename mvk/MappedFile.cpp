@@ -0,0 +1,139 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace mvk;
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: mappedData(other.mappedData),
+	  mappedSize(other.mappedSize)
+{
+	other.mappedData = nullptr;
+	other.mappedSize = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+
+		mappedData = other.mappedData;
+		mappedSize = other.mappedSize;
+
+		other.mappedData = nullptr;
+		other.mappedSize = 0;
+	}
+
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+	close();
+
+#ifdef _WIN32
+	const auto file = CreateFileW(path.c_str(), GENERIC_READ,
+	                              FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                              FILE_ATTRIBUTE_NORMAL |
+	                              FILE_FLAG_SEQUENTIAL_SCAN,
+	                              nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0,
+	                                        0, nullptr);
+
+	// The view keeps the mapping alive, handles can be closed right away
+	CloseHandle(file);
+
+	if (!mapping)
+	{
+		return false;
+	}
+
+	const auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	CloseHandle(mapping);
+
+	if (!view)
+	{
+		return false;
+	}
+
+	mappedData = static_cast<const unsigned char*>(view);
+	mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const auto file = ::open(path.c_str(), O_RDONLY);
+
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat{};
+
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(file);
+		return false;
+	}
+
+	const auto size = static_cast<size_t>(fileStat.st_size);
+	const auto view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+	::close(file);
+
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	mappedData = static_cast<const unsigned char*>(view);
+	mappedSize = size;
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (!mappedData)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(mappedData);
+#else
+	munmap(const_cast<unsigned char*>(mappedData), mappedSize);
+#endif
+
+	mappedData = nullptr;
+	mappedSize = 0;
+}
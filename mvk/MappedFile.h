@@ -0,0 +1,34 @@
+#pragma once
+
+#include <filesystem>
+
+namespace mvk
+{
+	/**
+	 * Read-only memory mapping of a whole file. The mapping is released when
+	 * the object is destroyed or closed, so views into data() must not
+	 * outlive it.
+	 **/
+	class MappedFile
+	{
+		const unsigned char* mappedData = nullptr;
+		size_t mappedSize = 0;
+
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		~MappedFile();
+
+		bool open(const std::filesystem::path& path);
+		void close();
+
+		bool isOpen() const { return mappedData != nullptr; }
+		const unsigned char* data() const { return mappedData; }
+		size_t size() const { return mappedSize; }
+	};
+}
@@ -0,0 +1,496 @@
+#include "MeshCache.h"
+
+#include <array>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+using namespace mvk;
+
+namespace
+{
+	constexpr uint32_t meshCacheMagic = 0x4d4b564d; // "MVKM"
+	constexpr uint32_t meshCacheVersion = 9;
+
+	// Chunk payloads are aligned so mapped arrays can be used in place
+	constexpr uint64_t chunkAlignment = 16;
+
+	enum class ChunkId : uint32_t
+	{
+		eVertices,
+		eIndices,
+		eMeshlets,
+		eNodes,
+		eMaterials,
+		eImages,
+		eImageData,
+		eStrings,
+		eLods,
+		eDependencies
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint32_t chunkCount;
+		uint32_t options;
+		uint32_t vertexAttributes;
+		uint32_t reserved;
+	};
+
+	struct Chunk
+	{
+		ChunkId id;
+		uint32_t reserved = 0;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	struct SourceStamp
+	{
+		uint64_t size;
+		int64_t time;
+	};
+
+	bool getSourceStamp(const fs::path& source, SourceStamp& stamp)
+	{
+		std::error_code error;
+
+		const auto size = fs::file_size(source, error);
+
+		if (error)
+		{
+			return false;
+		}
+
+		const auto time = fs::last_write_time(source, error);
+
+		if (error)
+		{
+			return false;
+		}
+
+		stamp = {
+			.size = static_cast<uint64_t>(size),
+			.time = static_cast<int64_t>(time.time_since_epoch().count())
+		};
+
+		return true;
+	}
+
+	// Missing files stamp as zero, so that they are tracked too
+	SourceStamp getDependencyStamp(const fs::path& path)
+	{
+		SourceStamp stamp{};
+
+		if (!getSourceStamp(path, stamp))
+		{
+			stamp = {};
+		}
+
+		return stamp;
+	}
+
+	uint64_t alignChunk(const uint64_t offset)
+	{
+		return (offset + chunkAlignment - 1) & ~(chunkAlignment - 1);
+	}
+
+	template <typename T>
+	bool getChunk(const unsigned char* data, const size_t dataSize,
+	              const std::span<const Chunk> chunks, const ChunkId id,
+	              std::span<const T>& out)
+	{
+		for (const auto& chunk : chunks)
+		{
+			if (chunk.id != id)
+			{
+				continue;
+			}
+
+			if (chunk.offset % alignof(T) != 0 || chunk.size % sizeof(T) != 0
+				|| chunk.offset > dataSize
+				|| chunk.size > dataSize - chunk.offset)
+			{
+				return false;
+			}
+
+			out = std::span<const T>(
+				reinterpret_cast<const T*>(data + chunk.offset),
+				chunk.size / sizeof(T));
+
+			return true;
+		}
+
+		return false;
+	}
+}
+
+fs::path MeshCache::getCachePath(const fs::path& source)
+{
+	auto path = source;
+	path += ".mvkcache";
+
+	return path;
+}
+
+bool MeshCache::open(const fs::path& source, const uint32_t options)
+{
+	file.close();
+
+	SourceStamp stamp{};
+
+	if (!getSourceStamp(source, stamp) || !file.open(getCachePath(source)))
+	{
+		return false;
+	}
+
+	const auto data = file.data();
+	const auto dataSize = file.size();
+
+	if (dataSize < sizeof(Header))
+	{
+		file.close();
+		return false;
+	}
+
+	const auto header = reinterpret_cast<const Header*>(data);
+
+	if (header->magic != meshCacheMagic
+		|| header->version != meshCacheVersion
+		|| header->sourceSize != stamp.size
+		|| header->sourceTime != stamp.time
+		|| header->options != options
+		|| header->chunkCount >
+		(dataSize - sizeof(Header)) / sizeof(Chunk))
+	{
+		file.close();
+		return false;
+	}
+
+	const std::span chunks(reinterpret_cast<const Chunk*>(header + 1),
+	                       header->chunkCount);
+
+	std::span<const char> stringChunk;
+	std::span<const DependencyRecord> dependencies;
+
+	const auto valid =
+		getChunk(data, dataSize, chunks, ChunkId::eVertices, vertices)
+		&& getChunk(data, dataSize, chunks, ChunkId::eIndices, indices)
+		&& getChunk(data, dataSize, chunks, ChunkId::eMeshlets, meshlets)
+		&& getChunk(data, dataSize, chunks, ChunkId::eNodes, nodes)
+		&& getChunk(data, dataSize, chunks, ChunkId::eMaterials, materials)
+		&& getChunk(data, dataSize, chunks, ChunkId::eImages, images)
+		&& getChunk(data, dataSize, chunks, ChunkId::eImageData, imageData)
+		&& getChunk(data, dataSize, chunks, ChunkId::eStrings, stringChunk)
+		&& getChunk(data, dataSize, chunks, ChunkId::eLods, lods)
+		&& getChunk(data, dataSize, chunks, ChunkId::eDependencies,
+		            dependencies);
+
+	if (!valid)
+	{
+		file.close();
+		return false;
+	}
+
+	for (const auto& image : images)
+	{
+		if (image.dataOffset > imageData.size()
+			|| image.dataSize > imageData.size() - image.dataOffset)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	strings = std::string_view(stringChunk.data(), stringChunk.size());
+	vertexAttributes = header->vertexAttributes & allVertexAttributes;
+
+	const auto inStrings = [this](const uint32_t offset, const uint32_t size)
+	{
+		return offset <= strings.size() && size <= strings.size() - offset;
+	};
+
+	for (const auto& image : images)
+	{
+		if (!inStrings(image.uri.offset, image.uri.size))
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	const auto inRange = [](const uint32_t first, const uint32_t count,
+	                        const size_t size)
+	{
+		return first <= size && count <= size - first;
+	};
+
+	// Indices are absolute, every one must fall inside the node's vertices
+	const auto validIndices = [this, &inRange](const NodeRecord& node,
+	                                           const uint32_t first,
+	                                           const uint32_t count)
+	{
+		if (!inRange(first, count, indices.size()))
+		{
+			return false;
+		}
+
+		for (const auto index : indices.subspan(first, count))
+		{
+			if (index - node.startVertex >= node.vertexCount)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		const auto& node = nodes[i];
+
+		auto validNode = inStrings(node.nameOffset, node.nameSize)
+			&& node.parent >= -1 && node.parent < static_cast<int64_t>(i)
+			&& node.matId >= -1
+			&& node.matId < static_cast<int64_t>(materials.size())
+			&& inRange(node.startVertex, node.vertexCount, vertices.size())
+			&& validIndices(node, node.startIndex, node.indexCount)
+			&& inRange(node.firstLod, node.lodCount, lods.size())
+			&& inRange(node.firstMeshlet, node.meshletCount,
+			           meshlets.size());
+
+		for (uint32_t l = 0; validNode && l < node.lodCount; l++)
+		{
+			const auto& lod = lods[node.firstLod + l];
+
+			validNode = validIndices(node, lod.startIndex, lod.indexCount);
+		}
+
+		if (!validNode)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	for (const auto& dependency : dependencies)
+	{
+		if (!inStrings(dependency.path.offset, dependency.path.size))
+		{
+			file.close();
+			return false;
+		}
+
+		const auto path = source.parent_path() / std::string(
+			getString(dependency.path.offset, dependency.path.size));
+		const auto dependencyStamp = getDependencyStamp(path);
+
+		if (dependencyStamp.size != dependency.size
+			|| dependencyStamp.time != dependency.time)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool MeshCache::write(const fs::path& source, const MeshData& data,
+                      const uint32_t options)
+{
+	SourceStamp stamp{};
+
+	if (!getSourceStamp(source, stamp))
+	{
+		return false;
+	}
+
+	// Names and image paths share one string table
+	std::string strings;
+
+	const auto addString = [&strings](const std::string& string)
+	{
+		const StringRecord record{
+			.offset = static_cast<uint32_t>(strings.size()),
+			.size = static_cast<uint32_t>(string.size())
+		};
+
+		strings += string;
+
+		return record;
+	};
+
+	auto nodes = data.nodes;
+
+	for (size_t i = 0; i < nodes.size() && i < data.nodeNames.size(); i++)
+	{
+		const auto name = addString(data.nodeNames[i]);
+
+		nodes[i].nameOffset = name.offset;
+		nodes[i].nameSize = name.size;
+	}
+
+	std::vector<ImageRecord> images;
+	std::vector<unsigned char> imageData;
+	images.reserve(data.images.size());
+
+	for (const auto& image : data.images)
+	{
+		images.push_back({
+			.uri = addString(image.uri),
+			.dataOffset = imageData.size(),
+			.dataSize = image.encoded.size()
+		});
+
+		imageData.insert(imageData.end(), image.encoded.begin(),
+		                 image.encoded.end());
+	}
+
+	std::vector<DependencyRecord> dependencies;
+	dependencies.reserve(data.dependencies.size());
+
+	for (const auto& dependency : data.dependencies)
+	{
+		const auto dependencyStamp =
+			getDependencyStamp(source.parent_path() / dependency);
+
+		dependencies.push_back({
+			.path = addString(dependency),
+			.size = dependencyStamp.size,
+			.time = dependencyStamp.time
+		});
+	}
+
+	struct Payload
+	{
+		ChunkId id;
+		const void* data;
+		uint64_t size;
+	};
+
+	const std::array<Payload, 10> payloads = {
+		{
+			{
+				ChunkId::eVertices, data.vertices.data(),
+				data.vertices.size() * sizeof(Vertex)
+			},
+			{
+				ChunkId::eIndices, data.indices.data(),
+				data.indices.size() * sizeof(uint32_t)
+			},
+			{
+				ChunkId::eMeshlets, data.meshlets.data(),
+				data.meshlets.size() * sizeof(Meshlet)
+			},
+			{
+				ChunkId::eNodes, nodes.data(),
+				nodes.size() * sizeof(NodeRecord)
+			},
+			{
+				ChunkId::eMaterials, data.materials.data(),
+				data.materials.size() * sizeof(MaterialRecord)
+			},
+			{
+				ChunkId::eImages, images.data(),
+				images.size() * sizeof(ImageRecord)
+			},
+			{ChunkId::eImageData, imageData.data(), imageData.size()},
+			{ChunkId::eStrings, strings.data(), strings.size()},
+			{
+				ChunkId::eLods, data.lods.data(),
+				data.lods.size() * sizeof(MeshLod)
+			},
+			{
+				ChunkId::eDependencies, dependencies.data(),
+				dependencies.size() * sizeof(DependencyRecord)
+			}
+		}
+	};
+
+	const Header header{
+		.magic = meshCacheMagic,
+		.version = meshCacheVersion,
+		.sourceSize = stamp.size,
+		.sourceTime = stamp.time,
+		.chunkCount = static_cast<uint32_t>(payloads.size()),
+		.options = options,
+		.vertexAttributes = data.vertexAttributes,
+		.reserved = 0
+	};
+
+	std::array<Chunk, payloads.size()> chunks{};
+	auto offset = alignChunk(sizeof(Header) + sizeof chunks);
+
+	for (size_t i = 0; i < payloads.size(); i++)
+	{
+		chunks[i] = {
+			.id = payloads[i].id,
+			.offset = offset,
+			.size = payloads[i].size
+		};
+
+		offset = alignChunk(offset + payloads[i].size);
+	}
+
+	// Write to a temporary file first so that a reader never maps a
+	// partially written cache
+	const auto path = getCachePath(source);
+	auto temporaryPath = path;
+	temporaryPath += ".tmp";
+
+	{
+		std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+
+		if (!stream)
+		{
+			return false;
+		}
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof header);
+		stream.write(reinterpret_cast<const char*>(chunks.data()),
+		             sizeof chunks);
+
+		constexpr char padding[chunkAlignment] = {};
+
+		for (size_t i = 0; i < payloads.size(); i++)
+		{
+			const auto position = static_cast<uint64_t>(stream.tellp());
+
+			stream.write(padding,
+			             static_cast<std::streamsize>(chunks[i].offset -
+				             position));
+
+			if (payloads[i].size > 0)
+			{
+				stream.write(static_cast<const char*>(payloads[i].data),
+				             static_cast<std::streamsize>(payloads[i].size));
+			}
+		}
+
+		if (!stream)
+		{
+			stream.close();
+			fs::remove(temporaryPath);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	fs::rename(temporaryPath, path, error);
+
+	if (error)
+	{
+		std::cerr << "Failed to write mesh cache: " << path << std::endl;
+		fs::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
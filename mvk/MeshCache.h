@@ -0,0 +1,202 @@
+#pragma once
+
+#include "Vertex.h"
+#include "VertexLayout.hpp"
+#include "BaseMaterial.h"
+#include "MappedFile.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+
+#include <glm/glm.hpp>
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mvk
+{
+	/**
+	 * Flattened Node, parents are referenced by their index in the node
+	 * array and always come before their children. Loaders store nodes
+	 * in pre-order, the reader rejects any other layout.
+	 **/
+	struct NodeRecord
+	{
+		int32_t parent = -1;
+		int32_t id = -1;
+		int32_t matId = -1;
+		uint32_t hasIndices = 0;
+		uint32_t hasMesh = 0;
+
+		uint32_t startVertex = 0;
+		uint32_t startIndex = 0;
+		uint32_t indexCount = 0;
+		uint32_t vertexCount = 0;
+
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
+
+		uint32_t firstLod = 0;
+		uint32_t lodCount = 0;
+
+		glm::vec3 boundsCenter = glm::vec3(0);
+		float boundsRadius = 0.0f;
+
+		uint32_t nameOffset = 0;
+		uint32_t nameSize = 0;
+
+		glm::mat4 localMatrix = glm::mat4(1);
+	};
+
+	/**
+	 * Material description with textures referenced by image index, -1 when
+	 * the slot is unused.
+	 **/
+	struct MaterialRecord
+	{
+		BaseMaterial::PushConstants constants;
+		AlphaMode alphaMode = NO_ALPHA;
+
+		int32_t baseColor = -1;
+		int32_t normal = -1;
+		int32_t metallicRoughness = -1;
+	};
+
+	struct StringRecord
+	{
+		uint32_t offset = 0;
+		uint32_t size = 0;
+	};
+
+	/**
+	 * Image referenced by a path relative to the source folder, or embedded
+	 * in the source, in which case the encoded file is stored in the cache.
+	 **/
+	struct ImageRecord
+	{
+		StringRecord uri;
+		uint64_t dataOffset = 0;
+		uint64_t dataSize = 0;
+	};
+
+	// File other than the source the cached data was read from
+	struct DependencyRecord
+	{
+		StringRecord path;
+		uint64_t size = 0;
+		int64_t time = 0;
+	};
+
+	// Move-only, encoded may point into its own encodedData: moving keeps
+	// the vector storage, copying would not
+	struct ImageSource
+	{
+		std::string uri;
+		// Embedded file, points into encodedData or into MeshData::source
+		std::span<const unsigned char> encoded;
+		std::vector<unsigned char> encodedData;
+
+		ImageSource() = default;
+		ImageSource(const ImageSource&) = delete;
+		ImageSource(ImageSource&&) noexcept = default;
+		ImageSource& operator=(const ImageSource&) = delete;
+		ImageSource& operator=(ImageSource&&) noexcept = default;
+	};
+
+	// Everything a loader produces, in the form the cache stores it
+	struct MeshData
+	{
+		std::vector<Vertex> vertices;
+		// Attributes the source provides, the others hold default values
+		VertexAttributeMask vertexAttributes = allVertexAttributes;
+		std::vector<uint32_t> indices;
+		std::vector<Meshlet> meshlets;
+		std::vector<MeshLod> lods;
+		std::vector<NodeRecord> nodes;
+		std::vector<std::string> nodeNames;
+		std::vector<MaterialRecord> materials;
+		std::vector<ImageSource> images;
+		// Buffers and images read next to the source, relative to its folder
+		std::vector<std::string> dependencies;
+		// Source file, mapped when images are read from it in place
+		MappedFile source;
+	};
+
+	/**
+	 * Binary cache of a parsed model, stored next to its source file.
+	 * The file is a header followed by a chunk table, so new chunks can be
+	 * added without breaking older readers. A cache is valid only for the
+	 * exact format version, size and modification time of its source and
+	 * of every file the source references.
+	 * Arrays are exposed as views into the mapped file.
+	 **/
+	class MeshCache
+	{
+		MappedFile file;
+
+		VertexAttributeMask vertexAttributes = allVertexAttributes;
+		std::span<const Vertex> vertices;
+		std::span<const uint32_t> indices;
+		std::span<const Meshlet> meshlets;
+		std::span<const MeshLod> lods;
+		std::span<const NodeRecord> nodes;
+		std::span<const MaterialRecord> materials;
+		std::span<const ImageRecord> images;
+		std::span<const unsigned char> imageData;
+		std::string_view strings;
+
+	public:
+
+		static std::filesystem::path getCachePath(
+			const std::filesystem::path& source);
+
+		/**
+		 * Returns false when there is no up to date cache for the source.
+		 * options is an opaque value describing how the data was processed,
+		 * a cache written with different options is not used.
+		 **/
+		bool open(const std::filesystem::path& source, uint32_t options = 0);
+
+		static bool write(const std::filesystem::path& source,
+		                  const MeshData& data, uint32_t options = 0);
+
+		std::span<const Vertex> getVertices() const { return vertices; }
+
+		VertexAttributeMask getVertexAttributes() const
+		{
+			return vertexAttributes;
+		}
+
+		std::span<const uint32_t> getIndices() const { return indices; }
+		std::span<const Meshlet> getMeshlets() const { return meshlets; }
+		std::span<const MeshLod> getLods() const { return lods; }
+		std::span<const NodeRecord> getNodes() const { return nodes; }
+
+		std::span<const MaterialRecord> getMaterials() const
+		{
+			return materials;
+		}
+
+		size_t getImageCount() const { return images.size(); }
+
+		std::string_view getImageUri(const size_t index) const
+		{
+			return getString(images[index].uri.offset, images[index].uri.size);
+		}
+
+		// Encoded image embedded in the source, empty for external images
+		std::span<const unsigned char> getImageData(const size_t index) const
+		{
+			return imageData.subspan(images[index].dataOffset,
+			                         images[index].dataSize);
+		}
+
+		std::string_view getString(const uint32_t offset,
+		                           const uint32_t size) const
+		{
+			return strings.substr(offset, size);
+		}
+	};
+}
@@ -0,0 +1,412 @@
+#include "MeshOptimizer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+using namespace mvk;
+
+namespace
+{
+	// A cluster ends early once its cache miss ratio gets this close to the
+	// ratio of the whole run it belongs to
+	constexpr float clusterThreshold = 1.05f;
+
+	constexpr uint32_t invalidIndex = ~0u;
+
+	// Vertex to triangles adjacency, in compressed rows
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+
+		Adjacency(const std::span<const uint32_t> indices,
+		          const size_t vertexCount)
+			: offsets(vertexCount + 1, 0),
+			  triangles(indices.size())
+		{
+			for (const auto index : indices)
+			{
+				offsets[index + 1]++;
+			}
+
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		std::span<const uint32_t> get(const uint32_t vertex) const
+		{
+			return std::span(triangles).subspan(
+				offsets[vertex], offsets[vertex + 1] - offsets[vertex]);
+		}
+	};
+
+	// Misses of a FIFO cache over triangles [begin, end)
+	uint32_t countCacheMisses(const std::span<const uint32_t> indices,
+	                          const uint32_t begin, const uint32_t end,
+	                          std::vector<uint32_t>& timestamps,
+	                          uint32_t& time)
+	{
+		uint32_t misses = 0;
+
+		for (auto t = begin; t < end; t++)
+		{
+			for (auto c = 0; c < 3; c++)
+			{
+				const auto index = indices[t * 3 + c];
+
+				if (time - timestamps[index] > MeshOptimizer::cacheSize)
+				{
+					timestamps[index] = time++;
+					misses++;
+				}
+			}
+		}
+
+		return misses;
+	}
+
+	/**
+	 * Splits the runs between dead ends into smaller clusters, each cut as
+	 * soon as its own miss ratio gets close to the run's one (Sander et al.)
+	 **/
+	std::vector<uint32_t> splitClusters(const std::span<const uint32_t> indices,
+	                                    const std::vector<uint32_t>& runs,
+	                                    const size_t vertexCount)
+	{
+		const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		std::vector<uint32_t> clusters;
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		auto time = MeshOptimizer::cacheSize + 1;
+
+		for (size_t r = 0; r < runs.size(); r++)
+		{
+			const auto begin = runs[r];
+			const auto end = r + 1 < runs.size() ? runs[r + 1] : triangleCount;
+
+			// Starting cold: push every cached entry out
+			time += MeshOptimizer::cacheSize + 1;
+
+			const auto runMisses = countCacheMisses(indices, begin, end,
+			                                        timestamps, time);
+			const auto runRatio = static_cast<float>(runMisses) /
+				static_cast<float>(end - begin);
+
+			time += MeshOptimizer::cacheSize + 1;
+
+			clusters.push_back(begin);
+
+			auto clusterBegin = begin;
+			uint32_t clusterMisses = 0;
+
+			for (auto t = begin; t < end; t++)
+			{
+				clusterMisses += countCacheMisses(indices, t, t + 1,
+				                                  timestamps, time);
+
+				const auto ratio = static_cast<float>(clusterMisses) /
+					static_cast<float>(t + 1 - clusterBegin);
+
+				if (t + 1 < end && ratio <= runRatio * clusterThreshold)
+				{
+					clusters.push_back(t + 1);
+
+					clusterBegin = t + 1;
+					clusterMisses = 0;
+					time += MeshOptimizer::cacheSize + 1;
+				}
+			}
+		}
+
+		return clusters;
+	}
+}
+
+std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(
+	const std::span<uint32_t> indices, const size_t vertexCount)
+{
+	const auto triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0 || vertexCount == 0)
+	{
+		return {};
+	}
+
+	const Adjacency adjacency(indices, vertexCount);
+
+	std::vector<uint32_t> liveTriangles(vertexCount);
+
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		liveTriangles[v] = static_cast<uint32_t>(adjacency.get(v).size());
+	}
+
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	// Dead end restarts, where a new run begins
+	std::vector<uint32_t> runs;
+
+	auto time = cacheSize + 1;
+	uint32_t cursor = 0;
+
+	const auto skipDeadEnd = [&]() -> uint32_t
+	{
+		while (!deadEnds.empty())
+		{
+			const auto vertex = deadEnds.back();
+			deadEnds.pop_back();
+
+			if (liveTriangles[vertex] > 0)
+			{
+				return vertex;
+			}
+		}
+
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (liveTriangles[cursor] > 0)
+			{
+				return cursor;
+			}
+		}
+
+		return invalidIndex;
+	};
+
+	auto fanning = skipDeadEnd();
+
+	runs.push_back(0);
+
+	while (fanning != invalidIndex)
+	{
+		candidates.clear();
+
+		for (const auto triangle : adjacency.get(fanning))
+		{
+			if (emitted[triangle])
+			{
+				continue;
+			}
+
+			for (auto c = 0; c < 3; c++)
+			{
+				const auto vertex = indices[triangle * 3 + c];
+
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+
+				liveTriangles[vertex]--;
+
+				if (time - timestamps[vertex] > cacheSize)
+				{
+					timestamps[vertex] = time++;
+				}
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// Next fanning vertex: the one still in cache that will stay there
+		// the longest once its remaining triangles are emitted
+		auto next = invalidIndex;
+		auto bestPriority = -1;
+
+		for (const auto vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+			{
+				continue;
+			}
+
+			auto priority = 0;
+
+			if (time - timestamps[vertex] + 2 * liveTriangles[vertex] <=
+				cacheSize)
+			{
+				priority = static_cast<int>(time - timestamps[vertex]);
+			}
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		if (next == invalidIndex)
+		{
+			next = skipDeadEnd();
+
+			if (next != invalidIndex)
+			{
+				runs.push_back(static_cast<uint32_t>(output.size() / 3));
+			}
+		}
+
+		fanning = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+
+	return splitClusters(indices, runs, vertexCount);
+}
+
+void MeshOptimizer::optimizeOverdraw(const std::span<uint32_t> indices,
+                                     const std::span<const Vertex> vertices,
+                                     const std::span<const uint32_t> clusters)
+{
+	const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	if (clusters.size() < 2)
+	{
+		return;
+	}
+
+	struct Cluster
+	{
+		uint32_t begin;
+		uint32_t end;
+		glm::vec3 centroid;
+		glm::vec3 normal;
+		float area;
+		float sortKey;
+	};
+
+	std::vector<Cluster> sorted(clusters.size());
+
+	glm::vec3 meshCentroid(0.0f);
+	auto meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		auto& cluster = sorted[c];
+
+		cluster = {
+			.begin = clusters[c],
+			.end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount,
+			.centroid = glm::vec3(0.0f),
+			.normal = glm::vec3(0.0f),
+			.area = 0.0f
+		};
+
+		for (auto t = cluster.begin; t < cluster.end; t++)
+		{
+			const auto& p0 = vertices[indices[t * 3 + 0]].position;
+			const auto& p1 = vertices[indices[t * 3 + 1]].position;
+			const auto& p2 = vertices[indices[t * 3 + 2]].position;
+
+			// Twice the area, weighting both sums the same way
+			const auto normal = glm::cross(p1 - p0, p2 - p0);
+			const auto area = glm::length(normal);
+
+			cluster.centroid += (p0 + p1 + p2) * (area / 3.0f);
+			cluster.normal += normal;
+			cluster.area += area;
+		}
+
+		meshCentroid += cluster.centroid;
+		meshArea += cluster.area;
+
+		if (cluster.area > 0.0f)
+		{
+			cluster.centroid /= cluster.area;
+		}
+	}
+
+	if (meshArea > 0.0f)
+	{
+		meshCentroid /= meshArea;
+	}
+
+	for (auto& cluster : sorted)
+	{
+		const auto length = glm::length(cluster.normal);
+
+		cluster.sortKey = length > 0.0f
+			                  ? glm::dot(cluster.centroid - meshCentroid,
+			                             cluster.normal / length)
+			                  : 0.0f;
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(),
+	                 [](const Cluster& a, const Cluster& b)
+	                 {
+		                 return a.sortKey > b.sortKey;
+	                 });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	for (const auto& cluster : sorted)
+	{
+		output.insert(output.end(), indices.begin() + cluster.begin * 3,
+		              indices.begin() + cluster.end * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void MeshOptimizer::optimizeVertexFetch(const std::span<Vertex> vertices,
+                                        const std::span<uint32_t> indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), invalidIndex);
+	uint32_t next = 0;
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == invalidIndex)
+		{
+			remap[index] = next++;
+		}
+
+		index = remap[index];
+	}
+
+	for (auto& target : remap)
+	{
+		if (target == invalidIndex)
+		{
+			target = next++;
+		}
+	}
+
+	std::vector<Vertex> reordered(vertices.size());
+
+	for (size_t v = 0; v < vertices.size(); v++)
+	{
+		reordered[remap[v]] = vertices[v];
+	}
+
+	std::copy(reordered.begin(), reordered.end(), vertices.begin());
+}
+
+void MeshOptimizer::optimize(const std::span<Vertex> vertices,
+                             const std::span<uint32_t> indices)
+{
+	if (indices.size() < 3 || vertices.empty())
+	{
+		return;
+	}
+
+	const auto triangles = indices.first(indices.size() / 3 * 3);
+
+	const auto clusters = optimizeVertexCache(triangles, vertices.size());
+
+	optimizeOverdraw(triangles, vertices, clusters);
+	optimizeVertexFetch(vertices, indices);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <span>
+#include <vector>
+
+namespace mvk
+{
+	/**
+	 * Index and vertex reordering for a single mesh range. Indices are local
+	 * to the given vertices. None of these change what is drawn, only the
+	 * order the GPU processes it in.
+	 **/
+	class MeshOptimizer
+	{
+	public:
+
+		// Vertex cache size Tipsify optimizes for
+		static constexpr uint32_t cacheSize = 16;
+
+		/**
+		 * Tipsify (Sander et al. 2007) post-transform vertex cache ordering.
+		 * Returns the first triangle of every cluster: runs that can be
+		 * reordered between each other without hurting the cache much.
+		 **/
+		static std::vector<uint32_t> optimizeVertexCache(
+			std::span<uint32_t> indices, size_t vertexCount);
+
+		/**
+		 * Sorts clusters so that those facing away from the mesh center are
+		 * drawn first, which tends to occlude the rest early.
+		 **/
+		static void optimizeOverdraw(std::span<uint32_t> indices,
+		                             std::span<const Vertex> vertices,
+		                             std::span<const uint32_t> clusters);
+
+		// Orders vertices by first use, unused ones are moved at the end
+		static void optimizeVertexFetch(std::span<Vertex> vertices,
+		                                std::span<uint32_t> indices);
+
+		// Runs the three passes in order
+		static void optimize(std::span<Vertex> vertices,
+		                     std::span<uint32_t> indices);
+	};
+}
@@ -0,0 +1,439 @@
+#include "MeshSimplifier.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+using namespace mvk;
+
+namespace
+{
+	// Symmetric 4x4 matrix of the sum of squared distances to planes
+	struct Quadric
+	{
+		double a2, ab, ac, ad;
+		double b2, bc, bd;
+		double c2, cd;
+		double d2;
+
+		static Quadric fromPlane(const glm::dvec3& normal, const double d)
+		{
+			return {
+				normal.x * normal.x, normal.x * normal.y,
+				normal.x * normal.z, normal.x * d,
+				normal.y * normal.y, normal.y * normal.z, normal.y * d,
+				normal.z * normal.z, normal.z * d,
+				d * d
+			};
+		}
+
+		Quadric& operator+=(const Quadric& q)
+		{
+			a2 += q.a2;
+			ab += q.ab;
+			ac += q.ac;
+			ad += q.ad;
+			b2 += q.b2;
+			bc += q.bc;
+			bd += q.bd;
+			c2 += q.c2;
+			cd += q.cd;
+			d2 += q.d2;
+
+			return *this;
+		}
+
+		double evaluate(const glm::dvec3& p) const
+		{
+			const auto value =
+				a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z
+				+ 2 * ad * p.x + b2 * p.y * p.y + 2 * bc * p.y * p.z
+				+ 2 * bd * p.y + c2 * p.z * p.z + 2 * cd * p.z + d2;
+
+			return std::max(value, 0.0);
+		}
+	};
+
+	struct Collapse
+	{
+		double cost;
+		uint32_t from;
+		uint32_t to;
+		uint32_t fromVersion;
+		uint32_t toVersion;
+
+		bool operator>(const Collapse& other) const
+		{
+			return cost > other.cost;
+		}
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			const auto h = std::hash<float>();
+			return h(p.x) ^ h(p.y) * 31 ^ h(p.z) * 131;
+		}
+	};
+
+	uint64_t edgeKey(const uint32_t a, const uint32_t b)
+	{
+		return static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+	}
+
+	class Simplifier
+	{
+		std::span<const Vertex> vertices;
+		std::vector<uint32_t> indices;
+
+		std::vector<Quadric> quadrics;
+		std::vector<bool> locked;
+		std::vector<bool> removedVertex;
+		std::vector<bool> removedTriangle;
+		std::vector<uint32_t> versions;
+		std::vector<std::vector<uint32_t>> vertexTriangles;
+
+		std::priority_queue<Collapse, std::vector<Collapse>,
+		                    std::greater<>> queue;
+
+		// Scratch lists reused by every collapse
+		std::vector<uint32_t> fromNeighbours;
+		std::vector<uint32_t> toNeighbours;
+		std::vector<uint32_t> sharedNeighbours;
+
+		size_t triangleCount;
+
+		glm::dvec3 getPosition(const uint32_t vertex) const
+		{
+			return glm::dvec3(vertices[vertex].position);
+		}
+
+		glm::dvec3 getNormal(const uint32_t triangle,
+		                     const uint32_t moved,
+		                     const glm::dvec3& position) const
+		{
+			glm::dvec3 p[3];
+
+			for (auto c = 0; c < 3; c++)
+			{
+				const auto vertex = indices[triangle * 3 + c];
+				p[c] = vertex == moved ? position : getPosition(vertex);
+			}
+
+			return glm::cross(p[1] - p[0], p[2] - p[0]);
+		}
+
+		void lockBordersAndSeams()
+		{
+			// Vertices sharing a position with another one sit on a seam
+			std::unordered_map<glm::vec3, uint32_t, PositionHash> positions;
+
+			for (const auto& vertex : vertices)
+			{
+				positions[vertex.position]++;
+			}
+
+			for (uint32_t v = 0; v < vertices.size(); v++)
+			{
+				locked[v] = positions[vertices[v].position] > 1;
+			}
+
+			// Edges used by a single triangle are on an open border
+			std::unordered_map<uint64_t, uint32_t> edges;
+
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				for (auto c = 0; c < 3; c++)
+				{
+					edges[edgeKey(indices[t * 3 + c],
+					              indices[t * 3 + (c + 1) % 3])]++;
+				}
+			}
+
+			for (const auto& [key, count] : edges)
+			{
+				if (count == 1)
+				{
+					locked[key >> 32] = true;
+					locked[key & 0xffffffff] = true;
+				}
+			}
+		}
+
+		void pushCollapse(const uint32_t from, const uint32_t to)
+		{
+			if (locked[from])
+			{
+				return;
+			}
+
+			auto quadric = quadrics[from];
+			quadric += quadrics[to];
+
+			queue.push({
+				.cost = quadric.evaluate(getPosition(to)),
+				.from = from,
+				.to = to,
+				.fromVersion = versions[from],
+				.toVersion = versions[to]
+			});
+		}
+
+		void gatherNeighbours(const uint32_t vertex,
+		                      std::vector<uint32_t>& neighbours) const
+		{
+			neighbours.clear();
+
+			for (const auto triangle : vertexTriangles[vertex])
+			{
+				for (auto c = 0; c < 3; c++)
+				{
+					const auto other = indices[triangle * 3 + c];
+
+					if (other != vertex)
+					{
+						neighbours.push_back(other);
+					}
+				}
+			}
+
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+			                 neighbours.end());
+		}
+
+		void pushVertexCollapses(const uint32_t vertex)
+		{
+			gatherNeighbours(vertex, fromNeighbours);
+
+			for (const auto other : fromNeighbours)
+			{
+				pushCollapse(vertex, other);
+				pushCollapse(other, vertex);
+			}
+		}
+
+		void compactTriangles(const uint32_t vertex)
+		{
+			std::erase_if(vertexTriangles[vertex],
+			              [this](const uint32_t triangle)
+			              {
+				              return removedTriangle[triangle];
+			              });
+		}
+
+		bool isValid(const uint32_t from, const uint32_t to)
+		{
+			compactTriangles(from);
+			compactTriangles(to);
+
+			auto sharedTriangles = 0;
+
+			for (const auto triangle : vertexTriangles[from])
+			{
+				for (auto c = 0; c < 3; c++)
+				{
+					sharedTriangles += indices[triangle * 3 + c] == to ? 1 : 0;
+				}
+			}
+
+			// The edge is gone
+			if (sharedTriangles == 0)
+			{
+				return false;
+			}
+
+			// Link condition: more shared neighbours than the edge's
+			// opposite vertices would pinch the surface
+			gatherNeighbours(from, fromNeighbours);
+			gatherNeighbours(to, toNeighbours);
+
+			sharedNeighbours.clear();
+			std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(),
+			                      toNeighbours.begin(), toNeighbours.end(),
+			                      std::back_inserter(sharedNeighbours));
+
+			if (static_cast<int>(sharedNeighbours.size()) > sharedTriangles)
+			{
+				return false;
+			}
+
+			// Moving from onto to must not flip or collapse a triangle
+			const auto position = getPosition(to);
+
+			for (const auto triangle : vertexTriangles[from])
+			{
+				const auto* corners = &indices[triangle * 3];
+
+				if (corners[0] == to || corners[1] == to || corners[2] == to)
+				{
+					continue;
+				}
+
+				const auto before = getNormal(triangle, from,
+				                              getPosition(from));
+				const auto after = getNormal(triangle, from, position);
+
+				const auto beforeLength = glm::length(before);
+				const auto afterLength = glm::length(after);
+
+				if (afterLength <= 0.0
+					|| glm::dot(before, after) <
+					0.25 * beforeLength * afterLength)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void collapse(const uint32_t from, const uint32_t to)
+		{
+			for (const auto triangle : vertexTriangles[from])
+			{
+				auto* corners = &indices[triangle * 3];
+
+				if (corners[0] == to || corners[1] == to || corners[2] == to)
+				{
+					removedTriangle[triangle] = true;
+					triangleCount--;
+					continue;
+				}
+
+				for (auto c = 0; c < 3; c++)
+				{
+					if (corners[c] == from)
+					{
+						corners[c] = to;
+					}
+				}
+
+				vertexTriangles[to].push_back(triangle);
+			}
+
+			vertexTriangles[from].clear();
+			removedVertex[from] = true;
+
+			quadrics[to] += quadrics[from];
+			versions[to]++;
+
+			compactTriangles(to);
+			pushVertexCollapses(to);
+		}
+
+	public:
+
+		Simplifier(const std::span<const Vertex> vertices,
+		           const std::span<const uint32_t> indices)
+			: vertices(vertices),
+			  indices(indices.begin(), indices.end()),
+			  quadrics(vertices.size(), Quadric{}),
+			  locked(vertices.size(), false),
+			  removedVertex(vertices.size(), false),
+			  removedTriangle(indices.size() / 3, false),
+			  versions(vertices.size(), 0),
+			  vertexTriangles(vertices.size()),
+			  triangleCount(indices.size() / 3)
+		{
+			for (uint32_t t = 0; t < triangleCount; t++)
+			{
+				const auto i0 = this->indices[t * 3 + 0];
+				const auto i1 = this->indices[t * 3 + 1];
+				const auto i2 = this->indices[t * 3 + 2];
+
+				const auto p0 = getPosition(i0);
+				auto normal = glm::cross(getPosition(i1) - p0,
+				                         getPosition(i2) - p0);
+				const auto length = glm::length(normal);
+
+				if (length > 0.0)
+				{
+					normal /= length;
+
+					const auto plane = Quadric::fromPlane(
+						normal, -glm::dot(normal, p0));
+
+					quadrics[i0] += plane;
+					quadrics[i1] += plane;
+					quadrics[i2] += plane;
+				}
+
+				vertexTriangles[i0].push_back(t);
+				vertexTriangles[i1].push_back(t);
+				vertexTriangles[i2].push_back(t);
+			}
+
+			lockBordersAndSeams();
+
+			for (uint32_t v = 0; v < vertices.size(); v++)
+			{
+				pushVertexCollapses(v);
+			}
+		}
+
+		std::vector<uint32_t> run(const size_t targetCount, float& error)
+		{
+			auto maxCost = 0.0;
+
+			while (triangleCount * 3 > targetCount && !queue.empty())
+			{
+				const auto candidate = queue.top();
+				queue.pop();
+
+				const auto from = candidate.from;
+				const auto to = candidate.to;
+
+				if (removedVertex[from] || removedVertex[to]
+					|| versions[from] != candidate.fromVersion
+					|| versions[to] != candidate.toVersion
+					|| !isValid(from, to))
+				{
+					continue;
+				}
+
+				maxCost = std::max(maxCost, candidate.cost);
+
+				collapse(from, to);
+			}
+
+			error = static_cast<float>(std::sqrt(maxCost));
+
+			std::vector<uint32_t> result;
+			result.reserve(triangleCount * 3);
+
+			for (size_t t = 0; t < removedTriangle.size(); t++)
+			{
+				if (!removedTriangle[t])
+				{
+					result.insert(result.end(), indices.begin() + t * 3,
+					              indices.begin() + t * 3 + 3);
+				}
+			}
+
+			return result;
+		}
+	};
+}
+
+std::vector<uint32_t> MeshSimplifier::simplify(
+	const std::span<const Vertex> vertices,
+	const std::span<const uint32_t> indices,
+	const size_t targetCount,
+	float& error)
+{
+	error = 0.0f;
+
+	if (indices.size() <= targetCount || vertices.empty())
+	{
+		return std::vector<uint32_t>(indices.begin(), indices.end());
+	}
+
+	Simplifier simplifier(vertices, indices.first(indices.size() / 3 * 3));
+
+	return simplifier.run(targetCount, error);
+}
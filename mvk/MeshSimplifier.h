@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <span>
+#include <vector>
+
+namespace mvk
+{
+	// Index range of one level of detail, error is in model space units
+	struct MeshLod
+	{
+		uint32_t startIndex;
+		uint32_t indexCount;
+		float error;
+	};
+
+	class MeshSimplifier
+	{
+	public:
+
+		/**
+		 * Quadric error edge collapse (Garland and Heckbert) onto existing
+		 * vertices, so the vertex buffer is shared by every level. Vertices
+		 * on open borders and attribute seams never move. Indices are local
+		 * to vertices. Returns the new index list, stopping at targetCount
+		 * indices or when no valid collapse is left. error receives the
+		 * largest distance a collapse moved the surface by.
+		 **/
+		static std::vector<uint32_t> simplify(std::span<const Vertex> vertices,
+		                                      std::span<const uint32_t> indices,
+		                                      size_t targetCount,
+		                                      float& error);
+	};
+}
@@ -0,0 +1,141 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+using namespace mvk;
+
+namespace
+{
+	void computeBounds(Meshlet& meshlet, const std::span<const Vertex> vertices,
+	                   const std::span<const uint32_t> triangles)
+	{
+		glm::vec3 minimum(std::numeric_limits<float>::max());
+		glm::vec3 maximum(std::numeric_limits<float>::lowest());
+
+		for (const auto index : triangles)
+		{
+			minimum = glm::min(minimum, vertices[index].position);
+			maximum = glm::max(maximum, vertices[index].position);
+		}
+
+		meshlet.center = (minimum + maximum) * 0.5f;
+		meshlet.radius = 0.0f;
+
+		for (const auto index : triangles)
+		{
+			meshlet.radius = std::max(
+				meshlet.radius,
+				glm::length(vertices[index].position - meshlet.center));
+		}
+
+		// Cone: average face normal, opened enough to hold every face
+		std::vector<glm::vec3> normals;
+		normals.reserve(triangles.size() / 3);
+
+		glm::vec3 axis(0.0f);
+
+		for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+		{
+			const auto& p0 = vertices[triangles[t + 0]].position;
+			const auto& p1 = vertices[triangles[t + 1]].position;
+			const auto& p2 = vertices[triangles[t + 2]].position;
+
+			const auto normal = glm::cross(p1 - p0, p2 - p0);
+			const auto length = glm::length(normal);
+
+			if (length > 0.0f)
+			{
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+
+		meshlet.coneAxis = glm::vec3(0.0f);
+		meshlet.coneCutoff = 1.0f;
+
+		const auto axisLength = glm::length(axis);
+
+		if (normals.empty() || axisLength <= 0.0f)
+		{
+			return;
+		}
+
+		axis /= axisLength;
+
+		auto minimumDot = 1.0f;
+
+		for (const auto& normal : normals)
+		{
+			minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+		}
+
+		// A cone of 90 degrees or more culls nothing
+		if (minimumDot <= 0.0f)
+		{
+			return;
+		}
+
+		meshlet.coneAxis = axis;
+		meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+	}
+}
+
+std::vector<Meshlet> MeshletBuilder::build(
+	const std::span<const Vertex> vertices,
+	const std::span<const uint32_t> indices,
+	const uint32_t firstIndex)
+{
+	std::vector<Meshlet> meshlets;
+
+	std::unordered_set<uint32_t> meshletVertices;
+	meshletVertices.reserve(maxVertices * 2);
+
+	size_t begin = 0;
+
+	const auto flush = [&](const size_t end)
+	{
+		if (end == begin)
+		{
+			return;
+		}
+
+		Meshlet meshlet{
+			.firstIndex = firstIndex + static_cast<uint32_t>(begin),
+			.indexCount = static_cast<uint32_t>(end - begin),
+			.vertexCount = static_cast<uint32_t>(meshletVertices.size()),
+			.padding = 0
+		};
+
+		computeBounds(meshlet, vertices, indices.subspan(begin, end - begin));
+
+		meshlets.push_back(meshlet);
+
+		meshletVertices.clear();
+		begin = end;
+	};
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		auto newVertices = 0u;
+
+		for (auto c = 0; c < 3; c++)
+		{
+			newVertices += meshletVertices.contains(indices[t + c]) ? 0 : 1;
+		}
+
+		if (meshletVertices.size() + newVertices > maxVertices
+			|| (t - begin) / 3 + 1 > maxTriangles)
+		{
+			flush(t);
+		}
+
+		meshletVertices.insert(indices.begin() + t, indices.begin() + t + 3);
+	}
+
+	flush(indices.size() / 3 * 3);
+
+	return meshlets;
+}
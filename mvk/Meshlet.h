@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <glm/glm.hpp>
+
+#include <span>
+#include <vector>
+
+namespace mvk
+{
+	/**
+	 * Cluster of a node's triangles: a contiguous part of its index range,
+	 * so it can be drawn with a plain drawIndexed. The layout matches std430
+	 * for GPU side culling.
+	 **/
+	struct Meshlet
+	{
+		// Bounding sphere, in model space
+		glm::vec3 center;
+		float radius;
+
+		// Normal cone, a zero axis means it can't be backface culled
+		glm::vec3 coneAxis;
+		float coneCutoff;
+
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t vertexCount;
+		uint32_t padding;
+
+		// True when every triangle faces away from a model space eye
+		bool isBackfacing(const glm::vec3& eye) const
+		{
+			const auto direction = center - eye;
+
+			return glm::dot(direction, coneAxis) >=
+				coneCutoff * glm::length(direction) + radius;
+		}
+	};
+
+	class MeshletBuilder
+	{
+	public:
+
+		static constexpr uint32_t maxVertices = 64;
+		static constexpr uint32_t maxTriangles = 124;
+
+		/**
+		 * Greedily cuts an index range in meshlets, in triangle order, so
+		 * the ordering done by MeshOptimizer keeps them compact. indices
+		 * start at firstIndex in the model index buffer and index vertices.
+		 **/
+		static std::vector<Meshlet> build(std::span<const Vertex> vertices,
+		                                  std::span<const uint32_t> indices,
+		                                  uint32_t firstIndex);
+	};
+}
@@ -4,104 +4,163 @@
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 
+#include "Camera.h"
 #include "Vertex.h"
 #include "Model.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "UploadBatch.h"
+#include <algorithm>
+#include <execution>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
+#include <numeric>
 
 namespace fs = std::filesystem;
 
 using namespace mvk;
 
-// Node
-
-void Node::release(Device* device) const
+namespace
 {
-	device->destroyBuffer(matrixBuffer);
-}
+	/**
+	 * An exception leaving a parallel algorithm calls std::terminate, so
+	 * tasks capture theirs and the first one is rethrown after the loop.
+	 **/
+	class TaskErrors
+	{
+		std::mutex mutex;
+		std::exception_ptr error;
 
-glm::mat4 Node::getLocalMatrix() const
-{
-	return glm::scale(glm::translate(rotation, translation), scale) * matrix;
-}
+	public:
 
-glm::mat4 Node::getMatrix() const
-{
-	auto matrix = getLocalMatrix();
-	auto parent = this->parent;
+		void capture()
+		{
+			std::lock_guard lock(mutex);
 
-	while (parent)
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+
+		void rethrow() const
+		{
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+	};
+
+	// Base color images are sampled through an sRGB format, the others
+	// hold linear data
+	std::vector<vk::Format> getImageFormats(
+		const size_t imageCount,
+		const std::span<const MaterialRecord> materials)
 	{
-		matrix = parent->getLocalMatrix() * matrix;
-		parent = parent->parent;
-	}
+		std::vector<vk::Format> formats(imageCount,
+		                                vk::Format::eR8G8B8A8Unorm);
 
-	return matrix;
+		for (const auto& material : materials)
+		{
+			if (material.baseColor > -1 &&
+				static_cast<size_t>(material.baseColor) < imageCount)
+			{
+				formats[material.baseColor] = vk::Format::eR8G8B8A8Srgb;
+			}
+		}
+
+		return formats;
+	}
 }
 
-void Node::createLocalMatrixBuffer(Device* device)
+// Model
+uint32_t Model::addNode(Node node, const int32_t parent,
+                        const glm::mat4& localMatrix)
 {
-	const auto size = sizeof(glm::mat4);
-
-	const vk::BufferCreateInfo bufferCreateInfo{
-		.size = static_cast<vk::DeviceSize>(size),
-		.usage = vk::BufferUsageFlagBits::eUniformBuffer,
-	};
+	const auto index = transforms.add(parent, localMatrix);
+	nodes.push_back(std::move(node));
 
-	matrixBuffer =
-		alloc::allocateCpuToGpuBuffer(device->allocator, bufferCreateInfo);
+	return index;
 }
 
-void Node::writeDescriptorSets(Device* device)
+void Model::updateTransforms(const uint32_t frame)
 {
-	const vk::DescriptorBufferInfo descriptorBufferInfo{
-		.buffer = matrixBuffer.buffer,
-		.range = sizeof(NodeUBO)
-	};
+	const auto allFrames = static_cast<uint32_t>(
+		(uint64_t{1} << ptrDevice->framesInFlight) - 1);
 
-	for (const auto& descriptorSet : descriptorSets)
+	for (const auto transform : transforms.update())
 	{
-		const vk::WriteDescriptorSet writeDescriptorSet{
-			.dstSet = descriptorSet,
-			.dstBinding = 0,
-			.dstArrayElement = 0,
-			.descriptorCount = 1,
-			.descriptorType = vk::DescriptorType::eUniformBuffer,
-			.pBufferInfo = &descriptorBufferInfo
-		};
+		if (!staleFrames[transform])
+		{
+			staleTransforms.push_back(transform);
+		}
+
+		staleFrames[transform] = allFrames;
+	}
 
-		device->logicalDevice
-		      .updateDescriptorSets(1, &writeDescriptorSet, 0, nullptr);
+	if (staleTransforms.empty())
+	{
+		return;
 	}
+
+	const auto& uniformRing = ptrDevice->uniformRing;
+	const auto nodeData = uniformRing.getData(nodeAllocation, frame);
+	const auto frameBit = 1u << frame;
+
+	// Writes this frame's copies, keeps the transforms other frames lack
+	std::erase_if(staleTransforms, [&](const uint32_t transform)
+	{
+		if (staleFrames[transform] & frameBit)
+		{
+			writeNodeUbo(nodeData, transform);
+			staleFrames[transform] &= ~frameBit;
+		}
+
+		return staleFrames[transform] == 0;
+	});
+
+	uniformRing.flush(nodeAllocation, frame);
 }
 
-void Node::updateLocalMatrixObject(Device* device) const
+void Model::writeNodeUbo(unsigned char* nodeData,
+                         const uint32_t transform) const
 {
-	auto matrix = getMatrix();
+	const auto& node = nodes[transform];
 
-	mapDataToBuffer(device->allocator, matrixBuffer, &matrix,
-	                sizeof matrix);
-}
+	const NodeUBO nodeUbo{
+		.matrix = transforms.getWorldMatrix(transform),
+		.positionOffset = glm::vec4(node.positionOffset, 0.0f),
+		.positionScale = glm::vec4(node.positionScale, 0.0f)
+	};
 
+	memcpy(nodeData + nodeUboStride * transform, &nodeUbo, sizeof nodeUbo);
+}
 
-// Model
 void Model::setupDescriptors()
 {
 	if (!descriptorSetLayout)
 		createDescriptorSetLayout(ptrDevice);
 
+	// World matrices of the loaded hierarchy, before the first upload
+	transforms.update();
+	createNodeBuffer();
+
 	createDescriptorPool();
 	createDescriptorSets();
 }
 
 void Model::createDescriptorPool()
 {
+	// A single set, nodes only differ by their dynamic offset
 	vk::DescriptorPoolSize descriptorPoolSize{
-		.descriptorCount = static_cast<uint32_t>(nodes.size())
+		.type = vk::DescriptorType::eUniformBufferDynamic,
+		.descriptorCount = 1
 	};
 
 	const vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{
-		.maxSets = static_cast<uint32_t>(nodes.size()),
+		.maxSets = 1,
 		.poolSizeCount = 1,
 		.pPoolSizes = &descriptorPoolSize
 	};
@@ -110,6 +169,37 @@ void Model::createDescriptorPool()
 	                          .createDescriptorPool(descriptorPoolCreateInfo);
 }
 
+void Model::createNodeBuffer()
+{
+	const auto alignment = ptrDevice->physicalDevice.getProperties().limits.
+	                                  minUniformBufferOffsetAlignment;
+
+	nodeUboStride = (sizeof(NodeUBO) + alignment - 1) / alignment * alignment;
+
+	// Never empty, a model without nodes still binds a valid range
+	const auto count = std::max(transforms.size(), 1u);
+
+	auto& uniformRing = ptrDevice->uniformRing;
+
+	nodeAllocation = uniformRing.allocate(nodeUboStride * count);
+
+	for (uint32_t frame = 0; frame < ptrDevice->framesInFlight; frame++)
+	{
+		const auto nodeData = uniformRing.getData(nodeAllocation, frame);
+
+		for (uint32_t transform = 0; transform < transforms.size();
+		     transform++)
+		{
+			writeNodeUbo(nodeData, transform);
+		}
+
+		uniformRing.flush(nodeAllocation, frame);
+	}
+
+	staleFrames.assign(transforms.size(), 0);
+	staleTransforms.clear();
+}
+
 void Model::createDescriptorSets()
 {
 	const vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{
@@ -118,28 +208,45 @@ void Model::createDescriptorSets()
 		.pSetLayouts = &descriptorSetLayout
 	};
 
-	for (const auto& node : nodes)
-	{
-		node->descriptorSets = ptrDevice->logicalDevice.
-		                                  allocateDescriptorSets(
-			                                  descriptorSetAllocateInfo);
+	descriptorSet = ptrDevice->logicalDevice.allocateDescriptorSets(
+		descriptorSetAllocateInfo).front();
 
-		node->createLocalMatrixBuffer(ptrDevice);
-		node->updateLocalMatrixObject(ptrDevice);
-		node->writeDescriptorSets(ptrDevice);
-	}
+	// Offset 0, dynamic offsets hold the whole position in the ring
+	const vk::DescriptorBufferInfo descriptorBufferInfo{
+		.buffer = ptrDevice->uniformRing.getBuffer(nodeAllocation),
+		.range = sizeof(NodeUBO)
+	};
+
+	const vk::WriteDescriptorSet writeDescriptorSet{
+		.dstSet = descriptorSet,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = vk::DescriptorType::eUniformBufferDynamic,
+		.pBufferInfo = &descriptorBufferInfo
+	};
+
+	ptrDevice->logicalDevice.updateDescriptorSets(1, &writeDescriptorSet, 0,
+	                                              nullptr);
 }
 
-void Model::release() const
+void Model::release()
 {
-	for (const auto& node : nodes)
+	if (loading.valid())
 	{
-		node->release(ptrDevice);
+		loading.wait();
 	}
 
+	ptrDevice->uniformRing.release(nodeAllocation);
+
 	for (const auto& texture : textures)
 	{
-		texture->release();
+		// The shared empty texture is released by the application, null
+		// when a failed load did not get to it
+		if (texture && texture != Texture2D::empty)
+		{
+			texture->release();
+		}
 	}
 
 	for (const auto& material : materials)
@@ -149,6 +256,7 @@ void Model::release() const
 
 	ptrDevice->destroyBuffer(vertexBuffer);
 	ptrDevice->destroyBuffer(indexBuffer);
+	ptrDevice->destroyBuffer(vertexDefaultsBuffer);
 
 	ptrDevice->logicalDevice.destroyDescriptorPool(descriptorPool);
 
@@ -159,115 +267,888 @@ void Model::release() const
 	descriptorSetLayout = nullptr;
 }
 
-void Model::loadRaw(Device* device, const vk::Queue transferQueue,
-                    std::vector<Vertex> vertices,
-                    std::vector<uint32_t> indices)
+void Model::uploadBuffers(const vk::Queue transferQueue,
+                          const std::span<const Vertex> vertices,
+                          const std::span<const uint32_t> indices,
+                          const VertexAttributeMask attributes)
 {
-	this->ptrDevice = device;
+	// Every buffer is uploaded by the same submit
+	UploadBatch batch(ptrDevice, transferQueue);
+
+	// Attributes the source does not have are not uploaded
+	vertexAttributes = attributes | toMask(VertexAttribute::ePosition);
+
+	if (!vertices.empty())
+	{
+		// Identity for full vertices
+		std::vector<PositionQuantization> quantizations(nodes.size());
+
+		vertexBuffer = visitVertexLayout(
+			vertexFormat, vertexAttributes, [&]<typename Layout>(Layout)
+			{
+				const auto encoded =
+					vertexFormat == VertexFormat::ePacked
+						? packVertices<Layout>(vertices, quantizations)
+						: Layout::encode(vertices);
+
+				return batch.createBuffer(
+					encoded.data(),
+					encoded.size() * sizeof(typename Layout::Type),
+					vk::BufferUsageFlagBits::eVertexBuffer);
+			});
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			nodes[i].positionOffset = quantizations[i].offset;
+			nodes[i].positionScale = quantizations[i].scale;
+		}
+
+		if (vertexAttributes != allVertexAttributes)
+		{
+			vertexDefaultsBuffer = batch.createBuffer(
+				&defaultVertex, sizeof defaultVertex,
+				vk::BufferUsageFlagBits::eVertexBuffer);
+		}
+	}
+
+	if (!indices.empty())
+	{
+		uint32_t maxVertexCount = 0;
+
+		for (const auto& node : nodes)
+		{
+			if (node.hasIndices)
+			{
+				maxVertexCount = std::max(maxVertexCount, node.vertexCount);
+			}
+		}
+
+		// Primitive restart is never enabled, 0xffff is a valid index
+		indexType = maxVertexCount <= 0x10000
+			            ? vk::IndexType::eUint16
+			            : vk::IndexType::eUint32;
+
+		if (indexType == vk::IndexType::eUint16)
+		{
+			const auto rebased = rebaseIndices<uint16_t>(indices);
+
+			indexBuffer = batch.createBuffer(
+				rebased.data(), rebased.size() * sizeof(uint16_t),
+				vk::BufferUsageFlagBits::eIndexBuffer);
+		}
+		else
+		{
+			const auto rebased = rebaseIndices<uint32_t>(indices);
+
+			indexBuffer = batch.createBuffer(
+				rebased.data(), rebased.size() * sizeof(uint32_t),
+				vk::BufferUsageFlagBits::eIndexBuffer);
+		}
+	}
+
+	batch.flush();
+}
 
-	const auto node = new Node;
+template <typename T>
+std::vector<T> Model::rebaseIndices(
+	const std::span<const uint32_t> indices) const
+{
+	std::vector<T> rebased(indices.size());
+
+	// Loaders produce absolute indices, every range a node owns is moved
+	// relative to its startVertex
+	std::for_each(std::execution::par, nodes.begin(), nodes.end(),
+	              [&](const Node& node)
+	              {
+		              if (!node.hasIndices)
+		              {
+			              return;
+		              }
+
+		              const auto rebase = [&](const uint32_t first,
+		                                      const uint32_t count)
+		              {
+			              for (auto i = first; i < first + count; i++)
+			              {
+				              rebased[i] = static_cast<T>(
+					              indices[i] - node.startVertex);
+			              }
+		              };
+
+		              if (node.lodCount == 0)
+		              {
+			              rebase(node.startIndex, node.indexCount);
+		              }
+
+		              // Level 0 is the node range
+		              for (uint32_t i = 0; i < node.lodCount; i++)
+		              {
+			              const auto& lod = lods[node.firstLod + i];
+			              rebase(lod.startIndex, lod.indexCount);
+		              }
+	              });
+
+	return rebased;
+}
+
+template <typename Layout>
+std::vector<typename Layout::Type> Model::packVertices(
+	const std::span<const Vertex> vertices,
+	std::vector<PositionQuantization>& quantizations) const
+{
+	std::vector<typename Layout::Type> packed(vertices.size());
+	quantizations.assign(nodes.size(), {});
+
+	// Every node is quantized per axis inside its bounding box
+	std::for_each(std::execution::par, nodes.begin(), nodes.end(),
+	              [&](const Node& node)
+	              {
+		              if (!node.hasMesh || node.vertexCount == 0)
+		              {
+			              return;
+		              }
+
+		              const auto nodeVertices = vertices.subspan(
+			              node.startVertex, node.vertexCount);
+
+		              auto min = nodeVertices[0].position;
+		              auto max = min;
+
+		              for (const auto& vertex : nodeVertices)
+		              {
+			              min = glm::min(min, vertex.position);
+			              max = glm::max(max, vertex.position);
+		              }
+
+		              auto& quantization =
+			              quantizations[&node - nodes.data()];
+
+		              quantization.offset = min;
+		              quantization.scale = glm::max(max - min,
+		                                            glm::vec3(1e-6f));
+
+		              for (uint32_t v = 0; v < node.vertexCount; v++)
+		              {
+			              const auto i = node.startVertex + v;
+
+			              packed[i] = Layout::encode(vertices[i],
+			                                         quantization);
+		              }
+	              });
+
+	return packed;
+}
+
+void Model::buildMeshlets(const std::span<const Vertex> vertices,
+                          const std::span<const uint32_t> indices)
+{
+	std::vector<std::vector<Meshlet>> nodeMeshlets(nodes.size());
+
+	std::transform(std::execution::par, nodes.begin(), nodes.end(),
+	               nodeMeshlets.begin(),
+	               [&](const Node& node)
+	               {
+		               if (!node.hasMesh || !node.hasIndices)
+		               {
+			               return std::vector<Meshlet>();
+		               }
+
+		               return MeshletBuilder::build(
+			               vertices,
+			               indices.subspan(node.startIndex, node.indexCount),
+			               node.startIndex);
+	               });
+
+	meshlets.clear();
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		nodes[i].firstMeshlet = static_cast<uint32_t>(meshlets.size());
+		nodes[i].meshletCount = static_cast<uint32_t>(nodeMeshlets[i].size());
+
+		meshlets.insert(meshlets.end(), nodeMeshlets[i].begin(),
+		                nodeMeshlets[i].end());
+	}
+}
+
+void Model::buildLods(const std::span<const Vertex> vertices,
+                      std::vector<uint32_t>& indices,
+                      const uint32_t lodCount, const bool optimize)
+{
+	struct LodLevel
+	{
+		std::vector<uint32_t> indices;
+		float error;
+	};
+
+	std::vector<std::vector<LodLevel>> nodeLevels(nodes.size());
+
+	std::transform(std::execution::par, nodes.begin(), nodes.end(),
+	               nodeLevels.begin(),
+	               [&](Node& node)
+	               {
+		               std::vector<LodLevel> levels;
+
+		               if (!node.hasMesh || node.vertexCount == 0)
+		               {
+			               return levels;
+		               }
+
+		               const auto nodeVertices = vertices.subspan(
+			               node.startVertex, node.vertexCount);
+
+		               auto min = nodeVertices[0].position;
+		               auto max = min;
+
+		               for (const auto& vertex : nodeVertices)
+		               {
+			               min = glm::min(min, vertex.position);
+			               max = glm::max(max, vertex.position);
+		               }
+
+		               node.boundsCenter = (min + max) * 0.5f;
+		               node.boundsRadius = 0.0f;
+
+		               for (const auto& vertex : nodeVertices)
+		               {
+			               node.boundsRadius = std::max(
+				               node.boundsRadius,
+				               glm::distance(node.boundsCenter,
+				                             vertex.position));
+		               }
+
+		               if (!node.hasIndices)
+		               {
+			               return levels;
+		               }
+
+		               // Every level is simplified from the previous one, so
+		               // errors add up along the chain
+		               std::vector<uint32_t> current(
+			               indices.begin() + node.startIndex,
+			               indices.begin() + node.startIndex
+			               + node.indexCount);
+
+		               for (auto& index : current)
+		               {
+			               index -= node.startVertex;
+		               }
+
+		               auto error = 0.0f;
+
+		               for (uint32_t level = 1; level < lodCount; level++)
+		               {
+			               const auto target = current.size() / 6 * 3;
+
+			               if (target < 3)
+			               {
+				               break;
+			               }
+
+			               auto levelError = 0.0f;
+
+			               auto simplified = MeshSimplifier::simplify(
+				               nodeVertices, current, target, levelError);
+
+			               // Locked borders and seams can stall the
+			               // simplification, a level barely smaller than the
+			               // previous one is not worth its memory
+			               if (simplified.empty()
+				               || simplified.size() * 5 > current.size() * 4)
+			               {
+				               break;
+			               }
+
+			               error += levelError;
+
+			               if (optimize)
+			               {
+				               MeshOptimizer::optimizeVertexCache(
+					               simplified, node.vertexCount);
+			               }
+
+			               levels.push_back({simplified, error});
+			               current = std::move(simplified);
+		               }
+
+		               return levels;
+	               });
+
+	lods.clear();
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		auto& node = nodes[i];
+
+		node.firstLod = static_cast<uint32_t>(lods.size());
+
+		if (node.hasMesh && node.hasIndices)
+		{
+			lods.push_back({node.startIndex, node.indexCount, 0.0f});
+		}
+
+		// Levels are appended after every node range, with absolute indices
+		for (const auto& level : nodeLevels[i])
+		{
+			lods.push_back({
+				static_cast<uint32_t>(indices.size()),
+				static_cast<uint32_t>(level.indices.size()),
+				level.error
+			});
+
+			for (const auto index : level.indices)
+			{
+				indices.push_back(index + node.startVertex);
+			}
+		}
 
-	node->startVertex = 0;
-	node->startIndex = 0;
+		node.lodCount = static_cast<uint32_t>(lods.size()) - node.firstLod;
+	}
+}
+
+MeshLod Model::selectLod(const Node* node, const Camera& camera,
+                         const float viewportHeight,
+                         const float pixelError) const
+{
+	if (node->lodCount == 0)
+	{
+		return {node->startIndex, node->indexCount, 0.0f};
+	}
+
+	const auto& matrix = getMatrix(node);
+	const auto center = glm::vec3(matrix * glm::vec4(node->boundsCenter, 1));
+	const auto scale = std::max({
+		glm::length(glm::vec3(matrix[0])),
+		glm::length(glm::vec3(matrix[1])),
+		glm::length(glm::vec3(matrix[2]))
+	});
 
-	node->indexCount = static_cast<uint32_t>(indices.size());
-	node->vertexCount = static_cast<uint32_t>(vertices.size());
+	// Fly cameras store a negated position, the view matrix is reliable
+	const auto eye = glm::vec3(glm::inverse(camera.viewMatrix)[3]);
 
-	nodes.push_back(node);
+	const auto distance = std::max(
+		glm::distance(center, eye) - node->boundsRadius * scale, 1e-4f);
 
-	const auto vSize =
-		static_cast<vk::DeviceSize>(sizeof vertices.at(0) * node->vertexCount);
+	// Pixels per model space unit at one unit from the eye
+	const auto projectionScale =
+		std::abs(camera.projMatrix[1][1]) * viewportHeight * 0.5f;
 
-	vertexBuffer = ptrDevice->transferDataSetToGpuBuffer(transferQueue,
-	                                                     vertices.data(), vSize,
-	                                                     vk::BufferUsageFlagBits
-	                                                     ::
-	                                                     eVertexBuffer);
+	auto selected = lods[node->firstLod];
 
-	if (node->indexCount > 0)
+	for (uint32_t i = 1; i < node->lodCount; i++)
 	{
-		const auto iSize =
-			static_cast<vk::DeviceSize>(sizeof indices.at(0) * node->indexCount
-			);
+		const auto& lod = lods[node->firstLod + i];
 
-		indexBuffer = ptrDevice->transferDataSetToGpuBuffer(transferQueue,
-		                                                    indices.data(),
-		                                                    iSize,
-		                                                    vk::
-		                                                    BufferUsageFlagBits
-		                                                    ::
-		                                                    eIndexBuffer);
+		if (lod.error * scale / distance * projectionScale > pixelError)
+		{
+			break;
+		}
+
+		selected = lod;
 	}
 
-	setupDescriptors();
+	return selected;
 }
 
+float Model::getViewDepth(const Node* node, const Camera& camera) const
+{
+	const auto center = camera.viewMatrix * getMatrix(node) *
+		glm::vec4(node->boundsCenter, 1.0f);
 
-void Model::loadFromFile(Device* device, const vk::Queue transferQueue,
-                         const char* filePath)
+	// The view looks down -z
+	return -center.z;
+}
+
+void Model::bindBuffers(const vk::CommandBuffer commandBuffer) const
 {
-	this->ptrDevice = device;
+	constexpr vk::DeviceSize offset = 0;
 
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+	commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer.buffer, &offset);
 
-	const fs::path path = filePath;
+	if (vertexDefaultsBuffer.buffer)
+	{
+		commandBuffer.bindVertexBuffers(vertexDefaultsBinding, 1,
+		                                &vertexDefaultsBuffer.buffer, &offset);
+	}
 
-	if (path.extension() == ".obj")
+	if (indexBuffer.buffer)
 	{
-		loadFromObjFile(filePath, vertices, indices);
+		commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0, indexType);
 	}
-	else if (path.extension() == ".gltf" || path.extension() == ".glb")
+}
+
+void Model::draw(const vk::CommandBuffer commandBuffer,
+                 const Node* node) const
+{
+	if (node->hasIndices)
 	{
-		loadFromGltfFile(transferQueue, filePath, vertices, indices);
+		draw(commandBuffer, node, {node->startIndex, node->indexCount, 0.0f});
 	}
 	else
+	{
+		commandBuffer.draw(node->vertexCount, 1, node->startVertex, 0);
+	}
+}
+
+void Model::draw(const vk::CommandBuffer commandBuffer, const Node* node,
+                 const MeshLod& range) const
+{
+	commandBuffer.drawIndexed(range.indexCount, 1, range.startIndex,
+	                          static_cast<int32_t>(node->startVertex), 0);
+}
+
+void Model::getVisibleRanges(const Node* node, const Camera& camera,
+                             std::vector<MeshLod>& ranges) const
+{
+	// Meshlet cones are in model space, so is the eye they are tested with
+	const auto modelView = camera.viewMatrix * getMatrix(node);
+	const auto eye = glm::vec3(glm::inverse(modelView)[3]);
+
+	MeshLod range{0, 0, 0.0f};
+
+	for (uint32_t i = 0; i < node->meshletCount; i++)
+	{
+		const auto& meshlet = meshlets[node->firstMeshlet + i];
+
+		if (meshlet.isBackfacing(eye))
+		{
+			continue;
+		}
+
+		// Meshlets adjacent in the index buffer share a draw
+		if (range.indexCount > 0
+			&& range.startIndex + range.indexCount == meshlet.firstIndex)
+		{
+			range.indexCount += meshlet.indexCount;
+			continue;
+		}
+
+		if (range.indexCount > 0)
+		{
+			ranges.push_back(range);
+		}
+
+		range = {meshlet.firstIndex, meshlet.indexCount, 0.0f};
+	}
+
+	if (range.indexCount > 0)
+	{
+		ranges.push_back(range);
+	}
+}
+
+void Model::loadRaw(Device* device, const vk::Queue transferQueue,
+                    std::vector<Vertex> vertices,
+                    std::vector<uint32_t> indices,
+                    const VertexAttributeMask attributes)
+{
+	this->ptrDevice = device;
+
+	addNode({
+		.hasIndices = !indices.empty(),
+		.hasMesh = true,
+		.startVertex = 0,
+		.startIndex = 0,
+		.indexCount = static_cast<uint32_t>(indices.size()),
+		.vertexCount = static_cast<uint32_t>(vertices.size())
+	}, TransformHierarchy::noParent, glm::mat4(1));
+
+	buildMeshlets(vertices, indices);
+	buildLods(vertices, indices, 1, false);
+	uploadBuffers(transferQueue, vertices, indices, attributes);
+
+	setupDescriptors();
+}
+
+
+void Model::loadFromFile(Device* device, const vk::Queue transferQueue,
+                         const char* filePath,
+                         const ModelLoadInfo& loadInfo)
+{
+	this->ptrDevice = device;
+
+	const fs::path path = filePath;
+	const auto extension = path.extension();
+
+	if (extension != ".obj" && extension != ".gltf" && extension != ".glb")
 	{
 		std::cerr << "Error : Loading" << filePath
 			<< ": extention not supported" << std::endl;
 		return;
 	}
 
-	const auto verticesCount = static_cast<uint32_t>(vertices.size());
-	const auto indicesCount = static_cast<uint32_t>(indices.size());
+	folder = path.parent_path().string();
+	vertexFormat = loadInfo.vertexFormat;
 
-	const auto vSize =
-		static_cast<vk::DeviceSize>(sizeof vertices.at(0) * verticesCount);
+	// Warm start: nothing is parsed, buffers are uploaded straight from the
+	// mapped cache
+	// A cache only matches the options it was built with
+	const auto cacheOptions = (loadInfo.optimizeMeshes ? 1u : 0u)
+		| loadInfo.lodCount << 8;
 
-	vertexBuffer = device->transferDataSetToGpuBuffer(transferQueue,
-	                                                  vertices.data(), vSize,
-	                                                  vk::BufferUsageFlagBits::
-	                                                  eVertexBuffer);
+	MeshCache cache;
 
-	if (indicesCount > 0)
+	if (cache.open(path, cacheOptions))
 	{
-		const auto iSize =
-			static_cast<vk::DeviceSize>(sizeof indices.at(0) * indicesCount);
+		loadFromCache(transferQueue, cache);
+		setupDescriptors();
+		return;
+	}
+
+	MeshData data;
+
+	if (extension == ".obj")
+	{
+		loadFromObjFile(filePath, data);
+	}
+	else
+	{
+		loadFromGltfFile(transferQueue, filePath, data);
+	}
+
+	if (loadInfo.optimizeMeshes)
+	{
+		optimizeMeshes(data);
+	}
+
+	// Meshlets only cover the full detail ranges
+	buildMeshlets(data.vertices, data.indices);
+	buildLods(data.vertices, data.indices, loadInfo.lodCount,
+	          loadInfo.optimizeMeshes);
+	uploadBuffers(transferQueue, data.vertices, data.indices,
+	              data.vertexAttributes);
+
+	data.meshlets = meshlets;
+	data.lods = lods;
+
+	writeNodeRecords(data);
 
-		indexBuffer = device->transferDataSetToGpuBuffer(transferQueue,
-		                                                 indices.data(), iSize,
-		                                                 vk::BufferUsageFlagBits
-		                                                 ::
-		                                                 eIndexBuffer);
+	if (!MeshCache::write(path, data, cacheOptions))
+	{
+		std::cerr << "Warn: mesh cache not written for " << filePath
+			<< std::endl;
 	}
 
 	setupDescriptors();
 }
 
+std::shared_future<void> Model::loadFromFileAsync(
+	Device* device, const vk::Queue transferQueue, std::string filePath,
+	const ModelLoadInfo& loadInfo)
+{
+	// Shared layouts are created lazily, never from the worker
+	getDescriptorSetLayout(device);
+	BaseMaterial::getDescriptorSetLayout(device);
+
+	loading = std::async(std::launch::async,
+	                     [this, device, transferQueue,
+		                     path = std::move(filePath), loadInfo]
+	                     {
+		                     loadFromFile(device, transferQueue, path.c_str(),
+		                                  loadInfo);
+	                     }).share();
+
+	return loading;
+}
+
+Texture2D* Model::createTexture(const vk::Queue transferQueue,
+                                 const std::string_view uri,
+                                 const std::span<const unsigned char> encoded,
+                                 const vk::Format format) const
+{
+	if (uri.empty() && encoded.empty())
+	{
+		return Texture2D::empty;
+	}
+
+	auto texture = new Texture2D;
+
+	try
+	{
+		if (!encoded.empty())
+		{
+			texture->loadFromMemory(ptrDevice, transferQueue, encoded.data(),
+			                        encoded.size(), format);
+		}
+		else
+		{
+			const auto path = folder + "/" + std::string(uri);
+
+			texture->loadFromFile(ptrDevice, transferQueue, path.c_str(),
+			                      format);
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+
+		delete texture;
+		texture = Texture2D::empty;
+	}
+	catch (...)
+	{
+		// Anything else is not a bad image, the caller handles it
+		delete texture;
+		throw;
+	}
+
+	return texture;
+}
+
+void Model::loadFromCache(const vk::Queue transferQueue,
+                          const MeshCache& cache)
+{
+	textures.resize(cache.getImageCount());
+
+	const auto formats = getImageFormats(cache.getImageCount(),
+	                                     cache.getMaterials());
+
+	std::vector<size_t> images(cache.getImageCount());
+	std::iota(images.begin(), images.end(), size_t{0});
+
+	TaskErrors errors;
+
+	std::transform(std::execution::par, images.begin(), images.end(),
+	               textures.begin(),
+	               [&](const size_t image) -> Texture2D*
+	               {
+		               try
+		               {
+			               return createTexture(transferQueue,
+			                                    cache.getImageUri(image),
+			                                    cache.getImageData(image),
+			                                    formats[image]);
+		               }
+		               catch (...)
+		               {
+			               errors.capture();
+			               return nullptr;
+		               }
+	               });
+
+	errors.rethrow();
+
+	createMaterials(cache.getMaterials());
+
+	const auto records = cache.getNodes();
+
+	nodes.reserve(records.size());
+
+	// Parents were range checked when the cache was opened
+	for (const auto& record : records)
+	{
+		addNode({
+			.name = std::string(cache.getString(record.nameOffset,
+			                                    record.nameSize)),
+			.id = record.id,
+			.matId = record.matId,
+			.hasIndices = record.hasIndices != 0,
+			.hasMesh = record.hasMesh != 0,
+			.startVertex = record.startVertex,
+			.startIndex = record.startIndex,
+			.indexCount = record.indexCount,
+			.vertexCount = record.vertexCount,
+			.firstMeshlet = record.firstMeshlet,
+			.meshletCount = record.meshletCount,
+			.firstLod = record.firstLod,
+			.lodCount = record.lodCount,
+			.boundsCenter = record.boundsCenter,
+			.boundsRadius = record.boundsRadius
+		}, record.parent, record.localMatrix);
+	}
+
+	const auto cachedMeshlets = cache.getMeshlets();
+	meshlets.assign(cachedMeshlets.begin(), cachedMeshlets.end());
+
+	const auto cachedLods = cache.getLods();
+	lods.assign(cachedLods.begin(), cachedLods.end());
+
+	uploadBuffers(transferQueue, cache.getVertices(), cache.getIndices(),
+	              cache.getVertexAttributes());
+}
+
+void Model::writeNodeRecords(MeshData& data) const
+{
+	data.nodes.clear();
+	data.nodeNames.clear();
+
+	for (uint32_t i = 0; i < nodes.size(); i++)
+	{
+		const auto& node = nodes[i];
+
+		data.nodes.push_back({
+			.parent = transforms.getParent(i),
+			.id = node.id,
+			.matId = node.matId,
+			.hasIndices = node.hasIndices,
+			.hasMesh = node.hasMesh,
+			.startVertex = node.startVertex,
+			.startIndex = node.startIndex,
+			.indexCount = node.indexCount,
+			.vertexCount = node.vertexCount,
+			.firstMeshlet = node.firstMeshlet,
+			.meshletCount = node.meshletCount,
+			.firstLod = node.firstLod,
+			.lodCount = node.lodCount,
+			.boundsCenter = node.boundsCenter,
+			.boundsRadius = node.boundsRadius,
+			.localMatrix = transforms.getLocalMatrix(i)
+		});
+
+		data.nodeNames.push_back(node.name);
+	}
+}
+
+void Model::optimizeMeshes(MeshData& data) const
+{
+	// Node ranges are disjoint, each one is optimized on its own
+	std::for_each(std::execution::par, nodes.begin(), nodes.end(),
+	              [&data](const Node& node)
+	              {
+		              if (!node.hasMesh || !node.hasIndices
+			              || node.vertexCount == 0)
+		              {
+			              return;
+		              }
+
+		              const auto vertices = std::span(data.vertices).subspan(
+			              node.startVertex, node.vertexCount);
+		              const auto indices = std::span(data.indices).subspan(
+			              node.startIndex, node.indexCount);
+
+		              // Indices are absolute, the optimizer works locally
+		              for (auto& index : indices)
+		              {
+			              index -= node.startVertex;
+		              }
+
+		              MeshOptimizer::optimize(vertices, indices);
+
+		              for (auto& index : indices)
+		              {
+			              index += node.startVertex;
+		              }
+	              });
+}
+
+void Model::createMaterials(const std::span<const MaterialRecord> records)
+{
+	const auto getTexture = [this](const int32_t index)
+	{
+		return index > -1 && static_cast<size_t>(index) < textures.size()
+			       ? textures[index]
+			       : Texture2D::empty;
+	};
+
+	for (const auto& record : records)
+	{
+		const BaseMaterial::BaseMaterialDescription materialDescription = {
+			.constants = record.constants,
+			.alphaMode = record.alphaMode,
+			.baseColor = getTexture(record.baseColor),
+			.normal = getTexture(record.normal),
+			.metallicRoughness = getTexture(record.metallicRoughness)
+		};
+
+		auto material = new BaseMaterial;
+
+		material->load(ptrDevice, materialDescription);
+
+		materials.push_back(material);
+	}
+}
+
+namespace
+{
+	/**
+	 * tinygltf image loader that stores the encoded file of images that
+	 * are not in a buffer view instead of decoding it, userData is a vector
+	 * of encoded images by index.
+	 **/
+	bool keepEncodedImage(tinygltf::Image* image, const int imageIndex,
+	                      std::string*, std::string*, int, int,
+	                      const unsigned char* bytes, const int size,
+	                      void* userData)
+	{
+		// Embedded images are decoded in place from the source file
+		if (image->bufferView > -1)
+		{
+			return true;
+		}
+
+		auto& encodedImages =
+			*static_cast<std::vector<std::vector<unsigned char>>*>(userData);
+
+		if (encodedImages.size() <= static_cast<size_t>(imageIndex))
+		{
+			encodedImages.resize(imageIndex + 1);
+		}
+
+		encodedImages[imageIndex].assign(bytes, bytes + size);
+
+		return true;
+	}
+
+	// Binary chunk of a GLB file, empty when the file is not a valid GLB or
+	// has no binary chunk
+	std::span<const unsigned char> getGlbBinaryChunk(const MappedFile& file)
+	{
+		constexpr uint32_t glbMagic = 0x46546C67; // "glTF"
+		constexpr uint32_t jsonChunkType = 0x4E4F534A; // "JSON"
+		constexpr uint32_t binaryChunkType = 0x004E4942; // "BIN\0"
+
+		const auto read = [&](const size_t offset)
+		{
+			uint32_t value;
+			memcpy(&value, file.data() + offset, sizeof value);
+			return value;
+		};
+
+		// 12 byte header then the JSON chunk header
+		if (file.size() < 20 || read(0) != glbMagic || read(4) != 2)
+		{
+			return {};
+		}
+
+		const auto length = static_cast<size_t>(read(8));
+
+		if (length > file.size() || read(16) != jsonChunkType)
+		{
+			return {};
+		}
+
+		const auto chunk = 20 + static_cast<size_t>(read(12));
+
+		if (chunk + 8 > length || read(chunk + 4) != binaryChunkType)
+		{
+			return {};
+		}
+
+		const auto binaryLength = static_cast<size_t>(read(chunk));
+
+		if (binaryLength > length - chunk - 8)
+		{
+			return {};
+		}
+
+		return {file.data() + chunk + 8, binaryLength};
+	}
+}
+
 void Model::loadFromGltfFile(const vk::Queue transferQueue,
                              const char* filePath,
-                             std::vector<Vertex>& vertices,
-                             std::vector<uint32_t>& indices)
+                             MeshData& data)
 {
 	tinygltf::Model model;
 	tinygltf::TinyGLTF loader;
 	std::string err;
 	std::string warn;
 
-	const fs::path path = filePath;
-	const fs::path parent = path.parent_path();
+	// Images are decoded after the parse, all at once
+	std::vector<std::vector<unsigned char>> encodedImages;
+	loader.SetImageLoader(keepEncodedImage, &encodedImages);
 
-	folder = parent.string();
+	const fs::path path = filePath;
 
 	auto ret = false;
 
@@ -277,7 +1158,16 @@ void Model::loadFromGltfFile(const vk::Queue transferQueue,
 	}
 	else if (path.extension() == ".glb")
 	{
-		ret = loader.LoadBinaryFromFile(&model, &err, &warn, filePath);
+		// Mapped rather than read, embedded images are decoded from it
+		if (!data.source.open(path))
+		{
+			throw std::runtime_error("Failed to open glTF binary");
+		}
+
+		ret = loader.LoadBinaryFromMemory(
+			&model, &err, &warn, data.source.data(),
+			static_cast<unsigned int>(data.source.size()),
+			path.parent_path().string());
 	}
 
 	if (!warn.empty())
@@ -295,412 +1185,502 @@ void Model::loadFromGltfFile(const vk::Queue transferQueue,
 		throw std::runtime_error("Failed to parse glTF");
 	}
 
+	// External buffers end up in the mesh cache, so does their stamp
+	for (const auto& buffer : model.buffers)
+	{
+		if (!buffer.uri.empty() && !tinygltf::IsDataURI(buffer.uri))
+		{
+			data.dependencies.push_back(buffer.uri);
+		}
+	}
+
+	// tinygltf copies the binary chunk into the first buffer, accessors
+	// and images read the mapped chunk instead
+	const auto glbBinary = data.source.isOpen()
+		                       ? getGlbBinaryChunk(data.source)
+		                       : std::span<const unsigned char>();
+
 	const auto iScene = model.defaultScene > -1 ? model.defaultScene : 0;
-	const auto scene = model.scenes[iScene];
+	const auto& scene = model.scenes[iScene];
 
-	loadTextures(transferQueue, model);
-	loadMaterials(model);
+	// Materials first, they tell which images hold sRGB colors
+	loadMaterials(model, data);
+	loadTextures(transferQueue, model, glbBinary, encodedImages, data);
+	createMaterials(data.materials);
+
+	// First pass: build the node hierarchy and reserve a vertex/index range
+	// for every primitive so that they can be decoded independently
+	std::vector<GltfPrimitive> primitives;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
 
 	for (const auto& iNode : scene.nodes)
 	{
-		const auto node = model.nodes[iNode];
-		loadGltfNode(nullptr, node, iNode, model, vertices, indices);
+		loadGltfNode(TransformHierarchy::noParent, model.nodes[iNode], iNode,
+		             model, glbBinary, primitives, vertexCount, indexCount);
 	}
-}
-
-void Model::loadFromObjFile(const char* filePath, std::vector<Vertex>& vertices,
-                            std::vector<uint32_t>& indices)
-{
-	tinyobj::attrib_t attribute;
-
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
 
-	if (!LoadObj(&attribute, &shapes, &materials, &err, filePath,
-	             "", true))
+	// Nothing reads the copy anymore
+	if (!glbBinary.empty() && !model.buffers.empty() &&
+		model.buffers[0].uri.empty())
 	{
-		throw std::runtime_error("Failed to load obj file" + err + warn);
+		std::vector<unsigned char>().swap(model.buffers[0].data);
 	}
 
-	for (const auto& shape : shapes)
-	{
-		auto node = new Node();
+	// Attributes any primitive has, the others are left out of the layout
+	data.vertexAttributes = toMask(VertexAttribute::ePosition);
 
-		node->indexCount = static_cast<uint32_t>(shape.mesh.indices.size());
-		node->startVertex = static_cast<uint32_t>(vertices.size());
+	for (const auto& primitive : primitives)
+	{
+		const std::pair<const GltfAccessorView*, VertexAttribute> views[] = {
+			{&primitive.colors, VertexAttribute::eColor},
+			{&primitive.normals, VertexAttribute::eNormal},
+			{&primitive.uv0, VertexAttribute::eTexCoord0},
+			{&primitive.uv1, VertexAttribute::eTexCoord1}
+		};
 
-		for (const auto& index : shape.mesh.indices)
+		for (const auto& [view, attribute] : views)
 		{
-			Vertex vertex;
-
-			vertex.position = {
-				attribute.vertices[3 * index.vertex_index + 0],
-				attribute.vertices[3 * index.vertex_index + 1],
-				attribute.vertices[3 * index.vertex_index + 2],
-			};
+			if (view->size() > 0)
+			{
+				data.vertexAttributes |= toMask(attribute);
+			}
+		}
+	}
 
-			vertex.texCoord = {
-				attribute.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attribute.texcoords[2 * index.texcoord_index + 1]
-			};
+	auto& vertices = data.vertices;
+	auto& indices = data.indices;
 
-			vertex.normal = {
-				attribute.normals[3 * index.normal_index + 0],
-				attribute.normals[3 * index.normal_index + 1],
-				attribute.normals[3 * index.normal_index + 2],
-			};
+	vertices.resize(vertexCount);
+	indices.resize(indexCount);
 
-			vertex.color = {1.0f, 1.0f, 1.0f};
+	// Second pass: decode primitives in parallel into their own ranges.
+	// Nothing may throw in there, index ranges are checked afterwards
+	std::vector<char> valid(primitives.size());
 
-			vertices.push_back(vertex);
+	std::transform(std::execution::par, primitives.begin(), primitives.end(),
+	               valid.begin(),
+	               [&](const GltfPrimitive& primitive) -> char
+	               {
+		               const auto& node = nodes[primitive.node];
 
-			indices.push_back(static_cast<uint16_t>(indices.size()));
-		}
+		               return decodeGltfPrimitive(
+			               primitive, node,
+			               vertices.data() + node.startVertex,
+			               indices.data() + node.startIndex);
+	               });
 
-		nodes.push_back(node);
+	if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+	{
+		throw std::runtime_error("glTF index out of vertex range");
 	}
 }
 
-void Model::loadGltfNode(Node* parent,
-                         const tinygltf::Node node,
-                         int nodeId,
-                         const tinygltf::Model model,
-                         std::vector<Vertex>& vertices,
-                         std::vector<uint32_t>& indices)
+void Model::loadFromObjFile(const char* filePath, MeshData& data)
 {
-	Node* pNode = new Node
+	const auto ranges = ObjLoader::load(filePath, data.vertices,
+	                                    data.indices);
+
+	// Missing normals are generated, colors are never read
+	data.vertexAttributes = toMask(VertexAttribute::ePosition)
+		| toMask(VertexAttribute::eNormal);
+
+	if (std::any_of(ranges.begin(), ranges.end(),
+	                [](const ObjRange& range) { return range.hasTexCoords; }))
 	{
-		.name = node.name.c_str(),
-		.id = nodeId,
-		.parent = parent
-	};
+		data.vertexAttributes |= toMask(VertexAttribute::eTexCoord0);
+	}
 
-	if (parent != nullptr)
+	for (size_t i = 0; i < ranges.size(); i++)
 	{
-		parent->childNodes.push_back(pNode);
+		const auto& range = ranges[i];
+
+		addNode({
+			.name = range.name,
+			.id = static_cast<int>(i),
+			.hasIndices = true,
+			.hasMesh = true,
+			.startVertex = range.startVertex,
+			.startIndex = range.startIndex,
+			.indexCount = range.indexCount,
+			.vertexCount = range.vertexCount
+		}, TransformHierarchy::noParent, glm::mat4(1));
 	}
+}
+
+void Model::loadGltfNode(const int32_t parent,
+                         const tinygltf::Node& node,
+                         const int nodeId,
+                         const tinygltf::Model& model,
+                         const std::span<const unsigned char> glbBinary,
+                         std::vector<GltfPrimitive>& primitives,
+                         uint32_t& vertexCount,
+                         uint32_t& indexCount)
+{
+	glm::mat4 matrix(1);
+	glm::vec3 translation(0);
+	glm::mat4 rotation(1);
+	glm::vec3 scale(1);
 
-	// Matrix
 	if (node.matrix.size() == 16)
 	{
-		pNode->matrix = glm::make_mat4(node.matrix.data());
+		matrix = glm::make_mat4(node.matrix.data());
 	}
 
-	// Translation
 	if (node.translation.size() == 3)
 	{
-		pNode->translation = glm::make_vec3(node.translation.data());
+		translation = glm::make_vec3(node.translation.data());
 	}
 
-	// Rotation
 	if (node.rotation.size() == 4)
 	{
-		const glm::quat q = glm::make_quat(node.rotation.data());
-		pNode->rotation = glm::mat4(q);
+		rotation = glm::mat4(glm::make_quat(node.rotation.data()));
 	}
 
-	// Scale
 	if (node.scale.size() == 3)
 	{
-		pNode->scale = glm::make_vec3(node.scale.data());
+		scale = glm::make_vec3(node.scale.data());
 	}
 
+	const auto localMatrix =
+		glm::scale(glm::translate(rotation, translation), scale) * matrix;
+
+	// Pre-order, the mesh cache relies on parents coming first. Indices
+	// are kept rather than pointers, nodes grows while children are added
+	const auto index = static_cast<int32_t>(nodes.size());
+
+	addNode({
+		.name = node.name,
+		.id = nodeId,
+		.hasMesh = node.mesh > -1
+	}, parent, localMatrix);
+
 	for (const auto& child : node.children)
 	{
-		loadGltfNode(pNode, model.nodes[child], child, model, vertices,
-		             indices);
+		loadGltfNode(index, model.nodes[child], child, model, glbBinary,
+		             primitives, vertexCount, indexCount);
+	}
+
+	if (!nodes[index].hasMesh)
+	{
+		return;
 	}
 
-	pNode->hasMesh = node.mesh > -1;
+	const auto& mesh = model.meshes[node.mesh];
+	auto meshAssigned = false;
 
-	// Node data
-	if (pNode->hasMesh)
+	for (const auto& primitive : mesh.primitives)
 	{
-		const auto& mesh = model.meshes[node.mesh];
+		const auto position = primitive.attributes.find("POSITION");
 
-		for (const auto& primitive : mesh.primitives)
+		if (position == primitive.attributes.end())
 		{
-			pNode->matId = primitive.material;
-			pNode->startVertex = static_cast<uint32_t>(vertices.size());
-			pNode->startIndex = static_cast<uint32_t>(indices.size());
+			continue;
+		}
 
-			// Position
-			const auto& posAccessor =
-				model.accessors[primitive.attributes.find("POSITION")->second];
+		// A node draws a single range: extra primitives of the mesh become
+		// child nodes sharing the parent transform
+		auto target = static_cast<uint32_t>(index);
 
-			const auto& posBufferView =
-				model.bufferViews[posAccessor.bufferView];
+		if (meshAssigned)
+		{
+			target = addNode({
+				.name = node.name,
+				.id = nodeId,
+				.hasMesh = true
+			}, index, glm::mat4(1));
+		}
 
-			const auto& posBuffer = model.buffers[posBufferView.buffer];
+		meshAssigned = true;
 
-			const auto& posStride =
-				posAccessor.ByteStride(posBufferView)
-					? posAccessor.ByteStride(posBufferView) / sizeof(
-						float)
-					: tinygltf::GetComponentSizeInBytes(TINYGLTF_TYPE_VEC3);
+		const auto findAccessor = [&](const char* name)
+		{
+			const auto attribute = primitive.attributes.find(name);
 
-			const auto& posData =
-				reinterpret_cast<const float*>(&posBuffer.data[
-					posAccessor.byteOffset +
-					posBufferView.byteOffset]);
+			return attribute != primitive.attributes.end()
+				       ? GltfAccessorView(model, attribute->second,
+				                          glbBinary)
+				       : GltfAccessorView();
+		};
 
-			pNode->vertexCount = static_cast<uint32_t>(posAccessor.count);
+		GltfPrimitive decoded{
+			.node = target,
+			.positions = GltfAccessorView(model, position->second,
+			                              glbBinary),
+			.colors = findAccessor("COLOR_0"),
+			.normals = findAccessor("NORMAL"),
+			.uv0 = findAccessor("TEXCOORD_0"),
+			.uv1 = findAccessor("TEXCOORD_1")
+		};
 
-			// UV0 
-			const float* uv0Data = nullptr;
-			uint32_t uv0Stride = 0;
+		auto& targetNode = nodes[target];
 
-			if (primitive.attributes.find("TEXCOORD_0") != primitive
-			                                               .attributes.end())
-			{
-				const auto& accessor =
-					model.accessors[primitive
-					                .attributes.find("TEXCOORD_0")->second];
+		targetNode.matId = primitive.material;
+		targetNode.hasIndices = primitive.indices > -1;
 
-				const auto& bufferView =
-					model.bufferViews[accessor.bufferView];
+		targetNode.startVertex = vertexCount;
+		targetNode.vertexCount =
+			static_cast<uint32_t>(model.accessors[position->second].count);
 
-				uv0Stride =
-					accessor.ByteStride(bufferView)
-						? accessor.ByteStride(bufferView) / sizeof(float)
-						: tinygltf::GetComponentSizeInBytes(TINYGLTF_TYPE_VEC2);
+		targetNode.startIndex = indexCount;
+		if (targetNode.hasIndices)
+		{
+			targetNode.indexCount = static_cast<uint32_t>(
+				model.accessors[primitive.indices].count);
+		}
 
-				uv0Data = reinterpret_cast<const float*>(&model.buffers[
-					bufferView.buffer].data[
-					accessor.byteOffset + bufferView.byteOffset]);
+		const auto attributeViews = {
+			&decoded.colors, &decoded.normals, &decoded.uv0, &decoded.uv1
+		};
+
+		for (const auto view : attributeViews)
+		{
+			// Missing attributes read as empty views
+			if (view->size() > 0 && view->size() < targetNode.vertexCount)
+			{
+				throw std::runtime_error("glTF attribute count mismatch");
 			}
+		}
 
-			// UV1
-			const float* uv1Data = nullptr;
-			uint32_t uv1Stride = 0;
+		if (targetNode.hasIndices)
+		{
+			decoded.indices = GltfAccessorView(model, primitive.indices,
+			                                   glbBinary);
 
-			if (primitive.attributes.find("TEXCOORD_1") != primitive
-			                                               .attributes.end())
+			if (!decoded.indices.isIndexType())
 			{
-				const auto& accessor =
-					model.accessors[primitive
-					                .attributes.find("TEXCOORD_1")->second];
+				throw std::runtime_error("Invalid glTF index component type");
+			}
+		}
 
-				const auto& bufferView =
-					model.bufferViews[accessor.bufferView];
+		vertexCount += targetNode.vertexCount;
+		indexCount += targetNode.indexCount;
 
-				uv1Stride =
-					accessor.ByteStride(bufferView)
-						? accessor.ByteStride(bufferView) / sizeof(float)
-						: tinygltf::GetComponentSizeInBytes(TINYGLTF_TYPE_VEC2);
+		primitives.push_back(decoded);
+	}
 
-				uv1Data = reinterpret_cast<const float*>(&model.buffers[
-					bufferView.buffer].data[
-					accessor.byteOffset + bufferView.byteOffset]);
-			}
+	nodes[index].hasMesh = meshAssigned;
+}
 
-			// Normal
-			const float* normalData = nullptr;
-			uint32_t normalStride = 0;
+bool Model::decodeGltfPrimitive(const GltfPrimitive& primitive,
+                                const Node& node,
+                                Vertex* vertices,
+                                uint32_t* indices)
+{
+	for (uint32_t v = 0; v < node.vertexCount; v++)
+	{
+		vertices[v] = Vertex{
+			.position = primitive.positions.read<3>(v),
+			.color = primitive.colors.size() > 0
+				         ? primitive.colors.read<3>(v)
+				         : defaultVertex.color,
+			.normal = primitive.normals.read<3>(v),
+			.texCoord = primitive.uv0.read<2>(v),
+			.texCoord1 = primitive.uv1.read<2>(v)
+		};
+	}
 
-			if (primitive.attributes.find("NORMAL") != primitive
-			                                           .attributes.end())
-			{
-				const auto& accessor =
-					model.accessors[primitive
-					                .attributes.find("NORMAL")->second];
-
-				const auto& bufferView =
-					model.bufferViews[accessor.bufferView];
-
-				normalStride =
-					accessor.ByteStride(bufferView)
-						? accessor.ByteStride(bufferView) / sizeof(
-							float)
-						: tinygltf::GetComponentSizeInBytes(TINYGLTF_TYPE_VEC3);
-
-				normalData = reinterpret_cast<const float*>(&model.buffers[
-					bufferView.buffer].data[
-					accessor.byteOffset + bufferView.byteOffset]);
-			}
+	if (!node.hasIndices)
+	{
+		return true;
+	}
 
-			// Create vertices
-			for (uint32_t v = 0; v < pNode->vertexCount; v++)
-			{
-				Vertex vertex{
-					.position = glm::make_vec3(&posData[v * posStride]),
-					.color = glm::vec3(0),
-					.normal = normalData
-						          ? glm::make_vec3(
-							          &normalData[v * normalStride])
-						          : glm::vec3(0),
-					.texCoord = uv0Data
-						            ? glm::make_vec2(&uv0Data[v * uv0Stride])
-						            : glm::vec2(0),
-					.texCoord1 = uv1Data
-						             ? glm::make_vec2(&uv1Data[v * uv1Stride])
-						             : glm::vec2(0)
-				};
-
-				vertices.push_back(vertex);
-			}
+	auto valid = true;
 
-			pNode->hasIndices = primitive.indices > -1;
+	for (uint32_t i = 0; i < node.indexCount; i++)
+	{
+		const auto index = primitive.indices.readIndex(i);
 
-			if (pNode->hasIndices)
-			{
-				const auto& accessor = model.accessors[primitive.indices];
-				const auto& bufferView = model.bufferViews[accessor.bufferView];
-				const auto& buffer = model.buffers[bufferView.buffer];
-
-				pNode->indexCount = static_cast<uint32_t>(accessor.count);
-
-				const void* dataPtr = &(buffer.data[accessor.byteOffset
-					+ bufferView.byteOffset]);
-
-				switch (accessor.componentType)
-				{
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
-					{
-						const auto buf = static_cast<const uint32_t*>(dataPtr);
-						for (size_t index = 0; index < accessor.count; index++)
-						{
-							indices.push_back(buf[index] + pNode->startVertex);
-						}
-						break;
-					}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
-					{
-						const auto buf = static_cast<const uint16_t*>(dataPtr);
-						for (size_t index = 0; index < accessor.count; index++)
-						{
-							indices.push_back(buf[index] + pNode->startVertex);
-						}
-						break;
-					}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
-					{
-						const auto buf = static_cast<const uint8_t*>(dataPtr);
-						for (size_t index = 0; index < accessor.count; index++)
-						{
-							indices.push_back(buf[index] + pNode->startVertex);
-						}
-						break;
-					}
-				}
-			}
+		// Later passes index the vertex array with these
+		if (index >= node.vertexCount)
+		{
+			valid = false;
 		}
+
+		indices[i] = index + node.startVertex;
 	}
 
-	this->nodes.push_back(pNode);
+	return valid;
 }
 
 void Model::loadTextures(const vk::Queue transferQueue,
-                         const tinygltf::Model model)
+                         const tinygltf::Model& model,
+                         const std::span<const unsigned char> glbBinary,
+                         std::vector<std::vector<unsigned char>>&
+                         encodedImages,
+                         MeshData& data)
 {
-	for (const auto& image : model.images)
+	encodedImages.resize(model.images.size());
+
+	// Buffer view images are read where they are, nothing is copied
+	std::vector<std::span<const unsigned char>> encoded(model.images.size());
+	std::vector<bool> inSource(model.images.size(), false);
+
+	for (size_t i = 0; i < model.images.size(); i++)
 	{
-		auto path = folder + "/" + image.uri;
+		const auto& image = model.images[i];
+
+		if (image.bufferView < 0)
+		{
+			encoded[i] = encodedImages[i];
+			continue;
+		}
 
-		Texture2D* texture;
+		const auto& bufferView = model.bufferViews.at(image.bufferView);
+		const auto& buffer = model.buffers.at(bufferView.buffer);
 
-		if (image.width > -1 && image.height > -1)
+		// The first buffer of a GLB without uri is its binary chunk
+		inSource[i] = bufferView.buffer == 0 && buffer.uri.empty()
+			&& !glbBinary.empty();
+
+		const auto bytes = inSource[i]
+			                   ? glbBinary
+			                   : std::span<const unsigned char>(buffer.data);
+
+		if (bufferView.byteOffset + bufferView.byteLength > bytes.size())
 		{
-			texture = new Texture2D;
+			std::cerr << "Image out of buffer range: " << i << std::endl;
+			continue;
+		}
 
-			if (image.bufferView > -1)
-			{
-				// TODO: load embedded textures
-			}
-			else
-			{
-				try
-				{
-					texture->loadRaw(ptrDevice, transferQueue,
-					                 image.image.data(), image.width,
-					                 image.height);
-				}
-				catch (std::runtime_error e)
-				{
-					std::cerr << "Failed to load: " << path;
-					continue;
-				}
-			}
+		encoded[i] = bytes.subspan(bufferView.byteOffset,
+		                           bufferView.byteLength);
+	}
+
+	textures.resize(model.images.size());
+
+	const auto formats = getImageFormats(model.images.size(),
+	                                     data.materials);
+
+	// Each image is uploaded by the thread that decoded it, as soon as it
+	// is decoded
+	TaskErrors errors;
+
+	std::transform(std::execution::par, model.images.begin(),
+	               model.images.end(), encoded.begin(), textures.begin(),
+	               [&](const tinygltf::Image& image,
+	                   const std::span<const unsigned char> bytes)
+	               -> Texture2D*
+	               {
+		               try
+		               {
+			               const auto i = &image - model.images.data();
+
+			               return createTexture(transferQueue, image.uri,
+			                                    bytes, formats[i]);
+		               }
+		               catch (...)
+		               {
+			               errors.capture();
+			               return nullptr;
+		               }
+	               });
+
+	errors.rethrow();
+
+	for (size_t i = 0; i < model.images.size(); i++)
+	{
+		const auto& image = model.images[i];
+
+		// Keep a reference to the encoded image for the mesh cache
+		ImageSource source;
+
+		if (inSource[i])
+		{
+			source.encoded = encoded[i];
+		}
+		else if (image.bufferView > -1)
+		{
+			// External buffers do not outlive the glTF model
+			source.encodedData.assign(encoded[i].begin(), encoded[i].end());
+			source.encoded = source.encodedData;
+		}
+		else if (tinygltf::IsDataURI(image.uri))
+		{
+			source.encodedData = std::move(encodedImages[i]);
+			source.encoded = source.encodedData;
 		}
 		else
 		{
-			texture = Texture2D::empty;
+			source.uri = image.uri;
+			data.dependencies.push_back(image.uri);
 		}
 
-		textures.push_back(texture);
+		data.images.push_back(std::move(source));
 	}
 }
 
-void Model::loadMaterials(const tinygltf::Model model)
+void Model::loadMaterials(const tinygltf::Model& model, MeshData& data)
 {
+	// Textures are referenced by image so records can outlive the glTF
+	const auto getImage = [&model](const int textureIndex) -> int32_t
+	{
+		if (textureIndex < 0)
+		{
+			return -1;
+		}
+
+		return model.textures[textureIndex].source;
+	};
+
 	for (const auto& mat : model.materials)
 	{
-		AlphaMode alphaMode;
+		MaterialRecord record;
 		auto alpha = mat.alphaMode;
 
 		if (alpha == "BLEND")
 		{
-			alphaMode = AlphaMode::ALPHA_BLEND;
+			record.alphaMode = AlphaMode::ALPHA_BLEND;
 		}
 		else if (alpha == "MASK")
 		{
-			alphaMode = AlphaMode::ALPHA_CUTOFF;
+			record.alphaMode = AlphaMode::ALPHA_CUTOFF;
 		}
 		else // Opaque or default
 		{
-			alphaMode = AlphaMode::NO_ALPHA;
+			record.alphaMode = AlphaMode::NO_ALPHA;
 		}
 
-		BaseMaterial::BaseMaterialDescription materialDescription = {
-			.alphaMode = alphaMode
-		};
-
 		// Constants
-		materialDescription.constants.baseColorFactor =
+		record.constants.baseColorFactor =
 			glm::vec4(
 				mat.pbrMetallicRoughness.baseColorFactor[0],
 				mat.pbrMetallicRoughness.baseColorFactor[1],
 				mat.pbrMetallicRoughness.baseColorFactor[2],
 				mat.pbrMetallicRoughness.baseColorFactor[3]);
 
-		materialDescription.constants.metallicFactor =
-			mat.pbrMetallicRoughness.metallicFactor;
+		record.constants.metallicFactor =
+			static_cast<float>(mat.pbrMetallicRoughness.metallicFactor);
 
-		materialDescription.constants.roughnessFactor =
-			mat.pbrMetallicRoughness.roughnessFactor;
+		record.constants.roughnessFactor =
+			static_cast<float>(mat.pbrMetallicRoughness.roughnessFactor);
 
 		// BaseColor
-		if (mat.pbrMetallicRoughness.baseColorTexture.index > -1)
+		record.baseColor =
+			getImage(mat.pbrMetallicRoughness.baseColorTexture.index);
+
+		if (record.baseColor > -1)
 		{
-			const auto& id =
-				model.textures[mat.pbrMetallicRoughness.baseColorTexture.index];
-			materialDescription.baseColor = textures[id.source];
-			materialDescription.constants.baseColorTextureSet = 0;
+			record.constants.baseColorTextureSet = 0;
 		}
 
 		// Normal
-		if (mat.normalTexture.index > -1)
+		record.normal = getImage(mat.normalTexture.index);
+
+		if (record.normal > -1)
 		{
-			const auto& id = model.textures[mat.normalTexture.index];
-			materialDescription.normal = textures[id.source];
-			materialDescription.constants.normalTextureSet = 0;
+			record.constants.normalTextureSet = 0;
 		}
 
 		// MetallicRoughness
-		if (mat.pbrMetallicRoughness.metallicRoughnessTexture.index > -1)
+		record.metallicRoughness =
+			getImage(mat.pbrMetallicRoughness.metallicRoughnessTexture.index);
+
+		if (record.metallicRoughness > -1)
 		{
-			const auto& id =
-				model.textures[
-					mat.pbrMetallicRoughness.metallicRoughnessTexture.index];
-			materialDescription.metallicRoughness = textures[id.source];
-			materialDescription.constants.metallicRoughnessTextureSet = 0;
+			record.constants.metallicRoughnessTextureSet = 0;
 		}
 
-		auto material = new BaseMaterial;
-
-		material->load(ptrDevice, materialDescription);
-
-		materials.push_back(material);
+		data.materials.push_back(record);
 	}
 }
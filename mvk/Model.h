@@ -1,12 +1,20 @@
 #pragma once
 
 #include "Vertex.h"
+#include "VertexLayout.hpp"
 #include "BaseMaterial.h"
 #include "GraphicPipeline.h"
+#include "GltfAccessor.hpp"
+#include "MeshCache.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "TransformHierarchy.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <future>
+
 // OBJ
 #include "../3rdParty/tiny_obj_loader.h"
 
@@ -14,85 +22,191 @@
 #define STBI_MSC_SECURE_CRT
 #include "../3rdParty/tiny_gltf.h"
 
+class Camera;
+
 namespace mvk
 {
 	struct NodeUBO
 	{
 		glm::mat4 matrix;
+		// Position dequantization, w unused
+		glm::vec4 positionOffset;
+		glm::vec4 positionScale;
 	};
 
+	/**
+	 * Drawable range of a model. Its parent, local and world matrices are
+	 * stored in Model::transforms, at the node's index in Model::nodes.
+	 **/
 	struct Node
 	{
-		const char* name;
+		std::string name;
 
 		int id;
 		int matId;
 		bool hasIndices;
 		bool hasMesh;
 
-		Node* parent = nullptr;
-		std::vector<Node*> childNodes;
-
 		uint32_t startVertex;
 		uint32_t startIndex;
 
 		uint32_t indexCount;
 		uint32_t vertexCount;
 
-		glm::mat4 matrix = glm::mat4(1);
-		glm::vec3 translation = glm::vec3(0);
-		glm::mat4 rotation = glm::mat4(1);
-		glm::vec3 scale = glm::vec3(1);
+		// Range in Model::meshlets
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
 
-		alloc::Buffer matrixBuffer;
+		// Range in Model::lods, level 0 is the node range itself
+		uint32_t firstLod = 0;
+		uint32_t lodCount = 0;
 
-		std::vector<vk::DescriptorSet> descriptorSets;
+		// Bounding sphere in model space
+		glm::vec3 boundsCenter = glm::vec3(0);
+		float boundsRadius = 0.0f;
 
-		void release(Device* device) const;
-
-		void createLocalMatrixBuffer(Device* device);
-		void writeDescriptorSets(Device* device);
-		void updateLocalMatrixObject(Device* device) const;
-
-		vk::DescriptorSet getDescriptorSet()
-		{
-			return descriptorSets[0];
-		}
+		// Maps packed positions back to model space, identity otherwise
+		glm::vec3 positionOffset = glm::vec3(0);
+		glm::vec3 positionScale = glm::vec3(1);
+	};
 
-		glm::mat4 getLocalMatrix() const;
-		glm::mat4 getMatrix() const;
+	struct ModelLoadInfo
+	{
+		// Reorder every node for the vertex cache, overdraw and vertex fetch.
+		// Off by default: it changes the vertex and index order callers see
+		bool optimizeMeshes = false;
+		// Levels of detail per node, the first one being the node itself.
+		// Every other level has about half the triangles of the previous one
+		uint32_t lodCount = 1;
+		// Layout of the uploaded vertices, the mesh cache keeps full ones
+		VertexFormat vertexFormat = VertexFormat::eFull;
 	};
 
 	class Model
 	{
 		Device* ptrDevice;
 
+		VertexFormat vertexFormat = VertexFormat::eFull;
+		VertexAttributeMask vertexAttributes = allVertexAttributes;
+		vk::IndexType indexType = vk::IndexType::eUint32;
+
 		alloc::Buffer modelMatrixBuffer;
 		vk::DescriptorPool descriptorPool;
 
+		// NodeUBO of every transform, nodeUboStride bytes apart, in the
+		// device's uniform ring. Bound through one dynamic uniform buffer
+		// descriptor, the offset selects the frame and the node.
+		UniformRing::Allocation nodeAllocation;
+		vk::DeviceSize nodeUboStride = 0;
+		vk::DescriptorSet descriptorSet;
+
+		std::shared_future<void> loading;
+
+		// One transform per node, at the same index
+		TransformHierarchy transforms;
+		// Bit f set while frame f's copy of the transform is out of date
+		std::vector<uint32_t> staleFrames;
+		// Transforms with stale frames
+		std::vector<uint32_t> staleTransforms;
+
 		inline static vk::DescriptorSetLayout descriptorSetLayout;
 
+		// The parent must have been added before, returns the node index
+		uint32_t addNode(Node node, int32_t parent,
+		                 const glm::mat4& localMatrix);
+
+		uint32_t getNodeIndex(const Node* node) const
+		{
+			return static_cast<uint32_t>(node - nodes.data());
+		}
+
 		void setupDescriptors();
 		void createDescriptorPool();
+		void createNodeBuffer();
 		void createDescriptorSets();
 
-		void loadTextures(vk::Queue transferQueue, tinygltf::Model model);
-
-		void loadMaterials(tinygltf::Model model);
+		void writeNodeUbo(unsigned char* nodeData, uint32_t transform) const;
 
-		void loadGltfNode(Node* parent, tinygltf::Node node, int nodeId,
-		                  tinygltf::Model model,
-		                  std::vector<Vertex>& vertices,
-		                  std::vector<uint32_t>& indices);
+		// Views are built, and so validated, before the parallel decode
+		struct GltfPrimitive
+		{
+			// Index in nodes, which still grows while primitives are added
+			uint32_t node;
+			GltfAccessorView positions;
+			GltfAccessorView colors;
+			GltfAccessorView normals;
+			GltfAccessorView uv0;
+			GltfAccessorView uv1;
+			GltfAccessorView indices;
+		};
+
+		// Encodes every node with its own position quantization, returned
+		// in quantizations by node index
+		template <typename Layout>
+		std::vector<typename Layout::Type> packVertices(
+			std::span<const Vertex> vertices,
+			std::vector<PositionQuantization>& quantizations) const;
+
+		template <typename T>
+		std::vector<T> rebaseIndices(std::span<const uint32_t> indices) const;
+
+		// Only the given attributes are uploaded, the others read defaults
+		void uploadBuffers(vk::Queue transferQueue,
+		                   std::span<const Vertex> vertices,
+		                   std::span<const uint32_t> indices,
+		                   VertexAttributeMask attributes);
+
+		void buildMeshlets(std::span<const Vertex> vertices,
+		                   std::span<const uint32_t> indices);
+
+		void buildLods(std::span<const Vertex> vertices,
+		               std::vector<uint32_t>& indices,
+		               uint32_t lodCount, bool optimize);
+
+		void createMaterials(std::span<const MaterialRecord> records);
+
+		void writeNodeRecords(MeshData& data) const;
+
+		void optimizeMeshes(MeshData& data) const;
+
+		void loadFromCache(vk::Queue transferQueue, const MeshCache& cache);
+
+		// Decoded from a path relative to folder or from an encoded file,
+		// Texture2D::empty when neither decodes
+		Texture2D* createTexture(vk::Queue transferQueue,
+		                         std::string_view uri,
+		                         std::span<const unsigned char> encoded,
+		                         vk::Format format) const;
+
+		// glbBinary is the mapped binary chunk of a GLB, empty otherwise
+		void loadTextures(vk::Queue transferQueue,
+		                  const tinygltf::Model& model,
+		                  std::span<const unsigned char> glbBinary,
+		                  std::vector<std::vector<unsigned char>>&
+		                  encodedImages,
+		                  MeshData& data);
+
+		// Records only, createMaterials runs once textures are loaded
+		void loadMaterials(const tinygltf::Model& model, MeshData& data);
+
+		void loadGltfNode(int32_t parent, const tinygltf::Node& node,
+		                  int nodeId,
+		                  const tinygltf::Model& model,
+		                  std::span<const unsigned char> glbBinary,
+		                  std::vector<GltfPrimitive>& primitives,
+		                  uint32_t& vertexCount,
+		                  uint32_t& indexCount);
+
+		static bool decodeGltfPrimitive(const GltfPrimitive& primitive,
+		                                const Node& node,
+		                                Vertex* vertices,
+		                                uint32_t* indices);
 
 		void loadFromGltfFile(vk::Queue transferQueue,
 		                      const char* filePath,
-		                      std::vector<Vertex>& vertices,
-		                      std::vector<uint32_t>& indices);
+		                      MeshData& data);
 
-		void loadFromObjFile(const char* filePath,
-		                     std::vector<Vertex>& vertices,
-		                     std::vector<uint32_t>& indices);
+		void loadFromObjFile(const char* filePath, MeshData& data);
 
 	public:
 
@@ -100,19 +214,131 @@ namespace mvk
 
 		std::vector<Texture2D*> textures;
 		std::vector<Material*> materials;
-		std::vector<Node*> nodes;
+		// Parents before their children
+		std::vector<Node> nodes;
+
+		std::vector<Meshlet> meshlets;
+		std::vector<MeshLod> lods;
 
 		alloc::Buffer vertexBuffer;
 		alloc::Buffer indexBuffer;
+		// defaultVertex, read by the attributes the vertex layout lacks
+		alloc::Buffer vertexDefaultsBuffer;
 
 		void loadRaw(Device* device, vk::Queue transferQueue,
 		             std::vector<Vertex> vertices,
-		             std::vector<uint32_t> indices);
+		             std::vector<uint32_t> indices,
+		             VertexAttributeMask attributes = allVertexAttributes);
 
 		void loadFromFile(Device* device, vk::Queue transferQueue,
-		                  const char* filePath);
+		                  const char* filePath,
+		                  const ModelLoadInfo& loadInfo = {});
+
+		/**
+		 * Loads the model on a worker thread, uploads go through
+		 * transferQueue. Nothing but isReady and release may be called
+		 * before the returned future is ready, get() rethrows load errors.
+		 **/
+		std::shared_future<void> loadFromFileAsync(
+			Device* device, vk::Queue transferQueue, std::string filePath,
+			const ModelLoadInfo& loadInfo = {});
+
+		// False while an asynchronous load is running
+		bool isReady() const
+		{
+			return !loading.valid()
+				|| loading.wait_for(std::chrono::seconds(0))
+				== std::future_status::ready;
+		}
+
+		void release();
+
+		// Pipelines drawing this model must use the matching layout
+		VertexFormat getVertexFormat() const { return vertexFormat; }
+
+		// Attributes stored in the vertex buffer
+		VertexAttributeMask getVertexAttributes() const
+		{
+			return vertexAttributes;
+		}
+
+		std::vector<vk::VertexInputBindingDescription>
+		getBindingDescriptions() const
+		{
+			return mvk::getBindingDescriptions(vertexFormat, vertexAttributes);
+		}
+
+		std::vector<vk::VertexInputAttributeDescription>
+		getAttributeDescriptions() const
+		{
+			return mvk::getAttributeDescriptions(vertexFormat,
+			                                     vertexAttributes);
+		}
+
+		/**
+		 * Index buffer width. Uploaded indices are relative to their node's
+		 * startVertex, 16 bits wide when every node has few enough vertices.
+		 **/
+		vk::IndexType getIndexType() const { return indexType; }
+
+		// Bound with the node's dynamic offset
+		vk::DescriptorSet getDescriptorSet() const { return descriptorSet; }
+
+		uint32_t getDynamicOffset(const Node* node, const uint32_t frame) const
+		{
+			const auto nodeData =
+				ptrDevice->uniformRing.getOffset(nodeAllocation, frame);
+
+			return static_cast<uint32_t>(nodeData +
+				nodeUboStride * getNodeIndex(node));
+		}
+
+		// World matrix of the node, as of the last updateTransforms
+		const glm::mat4& getMatrix(const Node* node) const
+		{
+			return transforms.getWorldMatrix(getNodeIndex(node));
+		}
+
+		// Applied by the next updateTransforms, along with the children
+		void setLocalMatrix(const Node* node, const glm::mat4& matrix)
+		{
+			transforms.setLocalMatrix(getNodeIndex(node), matrix);
+		}
 
-		void release() const;
+		/**
+		 * Recomputes the world matrices below the nodes whose local matrix
+		 * changed, and writes them to the frame's copy. The copies of the
+		 * other frames catch up when those frames are updated.
+		 **/
+		void updateTransforms(uint32_t frame);
+
+		// Binds the vertex buffers and the index buffer
+		void bindBuffers(vk::CommandBuffer commandBuffer) const;
+
+		// Draws the whole node, buffers must be bound
+		void draw(vk::CommandBuffer commandBuffer, const Node* node) const;
+
+		// Draws an index range of the node, a level of detail for instance
+		void draw(vk::CommandBuffer commandBuffer, const Node* node,
+		          const MeshLod& range) const;
+
+		/**
+		 * Appends the index ranges of the node's meshlets that may face the
+		 * camera, adjacent meshlets merged. Draw them like levels of detail.
+		 **/
+		void getVisibleRanges(const Node* node, const Camera& camera,
+		                      std::vector<MeshLod>& ranges) const;
+
+		/**
+		 * Picks the coarsest level of the node whose error, projected on
+		 * screen, stays under pixelError pixels. viewportHeight is in
+		 * pixels. Nodes without levels return their own range.
+		 **/
+		MeshLod selectLod(const Node* node, const Camera& camera,
+		                  float viewportHeight, float pixelError) const;
+
+		// View space depth of the node's bounding sphere center
+		float getViewDepth(const Node* node, const Camera& camera) const;
 
 		static vk::DescriptorSetLayout getDescriptorSetLayout(Device* device)
 		{
@@ -128,7 +354,7 @@ namespace mvk
 		{
 			const vk::DescriptorSetLayoutBinding uniformBufferLayoutBinding = {
 				.binding = 0,
-				.descriptorType = vk::DescriptorType::eUniformBuffer,
+				.descriptorType = vk::DescriptorType::eUniformBufferDynamic,
 				.descriptorCount = 1,
 				.stageFlags = vk::ShaderStageFlagBits::eVertex
 			};
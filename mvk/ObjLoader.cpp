@@ -0,0 +1,743 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+
+#include <glm/glm.hpp>
+
+#include "../3rdParty/tiny_obj_loader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+using namespace mvk;
+
+namespace
+{
+	// Parsing
+
+	constexpr size_t minChunkSize = 1 << 20;
+
+	enum RelativeIndex : uint8_t
+	{
+		eRelativeVertex = 1,
+		eRelativeNormal = 2,
+		eRelativeTexcoord = 4
+	};
+
+	/**
+	 * Face corner as read by a chunk. Negative OBJ indices are relative to
+	 * the attributes read so far, which the chunk only knows locally: they
+	 * are flagged and rebased once the previous chunks are counted.
+	 **/
+	struct RawCorner
+	{
+		tinyobj::index_t index;
+		uint8_t relative;
+	};
+
+	struct CornerHash
+	{
+		size_t operator()(const tinyobj::index_t& corner) const
+		{
+			constexpr uint64_t multiplier = 0x9e3779b97f4a7c15ull;
+
+			auto hash = static_cast<uint64_t>(
+				static_cast<uint32_t>(corner.vertex_index));
+			hash = hash * multiplier ^ static_cast<uint32_t>(
+				corner.normal_index);
+			hash = hash * multiplier ^ static_cast<uint32_t>(
+				corner.texcoord_index);
+
+			return static_cast<size_t>(hash ^ hash >> 32);
+		}
+
+		size_t operator()(const RawCorner& corner) const
+		{
+			return (*this)(corner.index) ^ corner.relative;
+		}
+	};
+
+	struct CornerEqual
+	{
+		bool operator()(const tinyobj::index_t& a,
+		                const tinyobj::index_t& b) const
+		{
+			return a.vertex_index == b.vertex_index
+				&& a.normal_index == b.normal_index
+				&& a.texcoord_index == b.texcoord_index;
+		}
+
+		bool operator()(const RawCorner& a, const RawCorner& b) const
+		{
+			return (*this)(a.index, b.index) && a.relative == b.relative;
+		}
+	};
+
+	/**
+	 * Faces of one shape inside one chunk, welded as they are parsed.
+	 * Corners are unique within the segment; they are resolved and merged
+	 * with the other segments of the shape once every chunk is parsed.
+	 **/
+	struct ObjSegment
+	{
+		// False when the segment continues the shape of the previous chunk
+		bool startsShape = false;
+		std::string name;
+
+		std::vector<RawCorner> corners;
+		// Local to the segment, index corners
+		std::vector<uint32_t> indices;
+	};
+
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<float> texcoords;
+
+		std::vector<ObjSegment> segments;
+
+		// Only alive while the chunk is parsed
+		std::unordered_map<RawCorner, uint32_t, CornerHash, CornerEqual>
+			cornerToIndex;
+
+		void addCorner(const RawCorner& corner)
+		{
+			auto& segment = segments.back();
+
+			const auto [entry, inserted] = cornerToIndex.try_emplace(
+				corner, static_cast<uint32_t>(segment.corners.size()));
+
+			if (inserted)
+			{
+				segment.corners.push_back(corner);
+			}
+
+			segment.indices.push_back(entry->second);
+		}
+
+		void startSegment(std::string name)
+		{
+			cornerToIndex.clear();
+
+			segments.push_back({
+				.startsShape = true,
+				.name = std::move(name)
+			});
+		}
+	};
+
+	bool isSpace(const char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+		{
+			p++;
+		}
+
+		return p;
+	}
+
+	const char* skipToken(const char* p, const char* end)
+	{
+		while (p < end && !isSpace(*p))
+		{
+			p++;
+		}
+
+		return p;
+	}
+
+	const char* parseFloat(const char* p, const char* end, float& value)
+	{
+		p = skipSpaces(p, end);
+
+		// from_chars does not accept an explicit plus sign
+		if (p < end && *p == '+')
+		{
+			p++;
+		}
+
+		const auto [next, error] = std::from_chars(p, end, value);
+
+		if (error != std::errc())
+		{
+			value = 0.0f;
+			return p;
+		}
+
+		return next;
+	}
+
+	void parseFloats(const char* p, const char* end, std::vector<float>& out,
+	                 const int count)
+	{
+		for (auto i = 0; i < count; i++)
+		{
+			float value;
+			p = parseFloat(p, end, value);
+			out.push_back(value);
+		}
+	}
+
+	int32_t resolveIndex(const int value, const size_t count,
+	                     uint8_t& relative, const uint8_t flag)
+	{
+		if (value > 0)
+		{
+			return value - 1;
+		}
+
+		if (value < 0)
+		{
+			relative |= flag;
+			return static_cast<int32_t>(count) + value;
+		}
+
+		// Index 0 does not exist in OBJ, it marks a missing attribute
+		return -1;
+	}
+
+	void parseFace(const char* p, const char* end, ObjChunk& chunk,
+	               std::vector<RawCorner>& face)
+	{
+		face.clear();
+
+		while ((p = skipSpaces(p, end)) < end)
+		{
+			// v, v/t, v//n or v/t/n
+			int values[3] = {0, 0, 0};
+
+			for (auto slot = 0; slot < 3; slot++)
+			{
+				if (slot > 0)
+				{
+					if (p >= end || *p != '/')
+					{
+						break;
+					}
+
+					p++;
+				}
+
+				if (p < end && *p == '+')
+				{
+					p++;
+				}
+
+				const auto [next, error] = std::from_chars(p, end,
+				                                           values[slot]);
+
+				if (error == std::errc())
+				{
+					p = next;
+				}
+			}
+
+			p = skipToken(p, end);
+
+			RawCorner corner{};
+
+			corner.index.vertex_index = resolveIndex(
+				values[0], chunk.positions.size() / 3, corner.relative,
+				eRelativeVertex);
+			corner.index.texcoord_index = resolveIndex(
+				values[1], chunk.texcoords.size() / 2, corner.relative,
+				eRelativeTexcoord);
+			corner.index.normal_index = resolveIndex(
+				values[2], chunk.normals.size() / 3, corner.relative,
+				eRelativeNormal);
+
+			face.push_back(corner);
+		}
+
+		// Fan triangulation, as tinyobj does
+		for (size_t i = 1; i + 1 < face.size(); i++)
+		{
+			chunk.addCorner(face[0]);
+			chunk.addCorner(face[i]);
+			chunk.addCorner(face[i + 1]);
+		}
+	}
+
+	void parseLine(const char* p, const char* end, ObjChunk& chunk,
+	               std::vector<RawCorner>& face)
+	{
+		p = skipSpaces(p, end);
+
+		const auto keywordEnd = skipToken(p, end);
+		const std::string_view keyword(p, keywordEnd - p);
+
+		p = keywordEnd;
+
+		if (keyword == "v")
+		{
+			parseFloats(p, end, chunk.positions, 3);
+		}
+		else if (keyword == "vn")
+		{
+			parseFloats(p, end, chunk.normals, 3);
+		}
+		else if (keyword == "vt")
+		{
+			parseFloats(p, end, chunk.texcoords, 2);
+		}
+		else if (keyword == "f")
+		{
+			parseFace(p, end, chunk, face);
+		}
+		else if (keyword == "o" || keyword == "g")
+		{
+			const auto nameBegin = skipSpaces(p, end);
+
+			chunk.startSegment(std::string(nameBegin,
+			                               skipToken(nameBegin, end)));
+		}
+	}
+
+	void parseChunk(ObjChunk& chunk)
+	{
+		std::vector<RawCorner> face;
+
+		// Until an 'o' or 'g', faces belong to the shape being parsed
+		chunk.segments.emplace_back();
+
+		auto p = chunk.begin;
+
+		while (p < chunk.end)
+		{
+			auto lineEnd = static_cast<const char*>(
+				memchr(p, '\n', chunk.end - p));
+
+			if (!lineEnd)
+			{
+				lineEnd = chunk.end;
+			}
+
+			if (p < lineEnd && *p != '#')
+			{
+				parseLine(p, lineEnd, chunk, face);
+			}
+
+			p = lineEnd + 1;
+		}
+
+		chunk.cornerToIndex = {};
+	}
+
+	// Welding
+
+	// Attribute arrays of the whole file
+	struct ObjAttributes
+	{
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<float> texcoords;
+	};
+
+	// Offsets of a chunk in the merged attribute arrays, in elements
+	struct ChunkBase
+	{
+		int32_t position;
+		int32_t normal;
+		int32_t texcoord;
+	};
+
+	struct ShapeSegment
+	{
+		const ObjSegment* segment;
+		ChunkBase base;
+	};
+
+	struct ObjShape
+	{
+		std::string name;
+		std::vector<ShapeSegment> segments;
+	};
+
+	struct WeldedShape
+	{
+		std::vector<Vertex> vertices;
+		// Local to the shape, rebased when merged
+		std::vector<uint32_t> indices;
+		bool hasTexCoords = false;
+		// Welding runs in parallel, errors are reported afterwards
+		bool valid = true;
+	};
+
+	tinyobj::index_t resolveCorner(const RawCorner& corner,
+	                               const ChunkBase& base)
+	{
+		auto index = corner.index;
+
+		if (corner.relative & eRelativeVertex)
+		{
+			index.vertex_index += base.position;
+		}
+
+		if (corner.relative & eRelativeNormal)
+		{
+			index.normal_index += base.normal;
+		}
+
+		if (corner.relative & eRelativeTexcoord)
+		{
+			index.texcoord_index += base.texcoord;
+		}
+
+		return index;
+	}
+
+	bool isValidCorner(const ObjAttributes& attributes,
+	                   const tinyobj::index_t& corner)
+	{
+		const auto v = static_cast<size_t>(corner.vertex_index);
+
+		return corner.vertex_index >= 0
+			&& 3 * v + 2 < attributes.positions.size();
+	}
+
+	Vertex makeVertex(const ObjAttributes& attributes,
+	                  const tinyobj::index_t& corner)
+	{
+		const auto v = static_cast<size_t>(corner.vertex_index);
+
+		Vertex vertex{
+			.position = {
+				attributes.positions[3 * v + 0],
+				attributes.positions[3 * v + 1],
+				attributes.positions[3 * v + 2]
+			},
+			.color = glm::vec3(1.0f),
+			.normal = glm::vec3(0.0f),
+			.texCoord = glm::vec2(0.0f),
+			.texCoord1 = glm::vec2(0.0f)
+		};
+
+		const auto n = static_cast<size_t>(corner.normal_index);
+
+		if (corner.normal_index >= 0 && 3 * n + 2 < attributes.normals.size())
+		{
+			vertex.normal = {
+				attributes.normals[3 * n + 0],
+				attributes.normals[3 * n + 1],
+				attributes.normals[3 * n + 2]
+			};
+		}
+
+		const auto t = static_cast<size_t>(corner.texcoord_index);
+
+		if (corner.texcoord_index >= 0
+			&& 2 * t + 1 < attributes.texcoords.size())
+		{
+			vertex.texCoord = {
+				attributes.texcoords[2 * t + 0],
+				1.0f - attributes.texcoords[2 * t + 1]
+			};
+		}
+
+		return vertex;
+	}
+
+	// Area weighted average of the adjacent face normals
+	void generateNormals(WeldedShape& shape,
+	                     const std::vector<bool>& missingNormals)
+	{
+		auto& vertices = shape.vertices;
+		const auto& indices = shape.indices;
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const auto i0 = indices[i + 0];
+			const auto i1 = indices[i + 1];
+			const auto i2 = indices[i + 2];
+
+			const auto faceNormal = glm::cross(
+				vertices[i1].position - vertices[i0].position,
+				vertices[i2].position - vertices[i0].position);
+
+			for (const auto index : {i0, i1, i2})
+			{
+				if (missingNormals[index])
+				{
+					vertices[index].normal += faceNormal;
+				}
+			}
+		}
+
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			const auto length = glm::length(vertices[v].normal);
+
+			if (missingNormals[v] && length > 0.0f)
+			{
+				vertices[v].normal /= length;
+			}
+		}
+	}
+
+	/**
+	 * Merges the segments of a shape. Segments are already welded, only
+	 * their unique corners are resolved and looked up here.
+	 **/
+	WeldedShape weldShape(const ObjAttributes& attributes,
+	                      const ObjShape& shape)
+	{
+		WeldedShape welded;
+
+		std::unordered_map<tinyobj::index_t, uint32_t, CornerHash, CornerEqual>
+			cornerToVertex;
+
+		std::vector<bool> missingNormals;
+		auto hasMissingNormals = false;
+
+		std::vector<uint32_t> remap;
+
+		for (const auto& [segment, base] : shape.segments)
+		{
+			remap.resize(segment->corners.size());
+
+			for (size_t c = 0; c < segment->corners.size(); c++)
+			{
+				const auto corner = resolveCorner(segment->corners[c], base);
+
+				const auto [entry, inserted] = cornerToVertex.try_emplace(
+					corner, static_cast<uint32_t>(welded.vertices.size()));
+
+				if (inserted)
+				{
+					if (!isValidCorner(attributes, corner))
+					{
+						welded.valid = false;
+						return welded;
+					}
+
+					welded.vertices.push_back(
+						makeVertex(attributes, corner));
+
+					welded.hasTexCoords |= corner.texcoord_index >= 0;
+
+					const auto missing = corner.normal_index < 0;
+
+					missingNormals.push_back(missing);
+					hasMissingNormals |= missing;
+				}
+
+				remap[c] = entry->second;
+			}
+
+			for (const auto index : segment->indices)
+			{
+				welded.indices.push_back(remap[index]);
+			}
+		}
+
+		if (hasMissingNormals)
+		{
+			generateNormals(welded, missingNormals);
+		}
+
+		return welded;
+	}
+}
+
+std::vector<ObjRange> ObjLoader::parse(const char* data, const size_t size,
+                                       std::vector<Vertex>& vertices,
+                                       std::vector<uint32_t>& indices)
+{
+	// Split in line aligned chunks, a few per core to balance the load
+	const auto maxChunks =
+		static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))
+		* 4;
+	const auto chunkCount = std::clamp<size_t>(size / minChunkSize, 1,
+	                                           maxChunks);
+
+	std::vector<ObjChunk> chunks(chunkCount);
+
+	const auto end = data + size;
+	auto begin = data;
+
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		auto chunkEnd = end;
+
+		if (c + 1 < chunkCount)
+		{
+			chunkEnd = std::max(begin, data + size * (c + 1) / chunkCount);
+
+			const auto newLine = static_cast<const char*>(
+				memchr(chunkEnd, '\n', end - chunkEnd));
+
+			chunkEnd = newLine ? newLine + 1 : end;
+		}
+
+		chunks[c].begin = begin;
+		chunks[c].end = chunkEnd;
+
+		begin = chunkEnd;
+	}
+
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+	              parseChunk);
+
+	std::vector<ChunkBase> bases(chunkCount);
+	size_t positionCount = 0;
+	size_t normalCount = 0;
+	size_t texcoordCount = 0;
+
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		bases[c] = {
+			.position = static_cast<int32_t>(positionCount / 3),
+			.normal = static_cast<int32_t>(normalCount / 3),
+			.texcoord = static_cast<int32_t>(texcoordCount / 2)
+		};
+
+		positionCount += chunks[c].positions.size();
+		normalCount += chunks[c].normals.size();
+		texcoordCount += chunks[c].texcoords.size();
+	}
+
+	if (positionCount / 3 > INT32_MAX || normalCount / 3 > INT32_MAX
+		|| texcoordCount / 2 > INT32_MAX)
+	{
+		throw std::runtime_error("OBJ too large for 32-bit indices");
+	}
+
+	ObjAttributes attributes;
+	attributes.positions.resize(positionCount);
+	attributes.normals.resize(normalCount);
+	attributes.texcoords.resize(texcoordCount);
+
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+	              [&](const ObjChunk& chunk)
+	              {
+		              const auto& base = bases[&chunk - chunks.data()];
+
+		              std::copy(chunk.positions.begin(), chunk.positions.end(),
+		                        attributes.positions.begin()
+		                        + 3 * size_t(base.position));
+		              std::copy(chunk.normals.begin(), chunk.normals.end(),
+		                        attributes.normals.begin()
+		                        + 3 * size_t(base.normal));
+		              std::copy(chunk.texcoords.begin(), chunk.texcoords.end(),
+		                        attributes.texcoords.begin()
+		                        + 2 * size_t(base.texcoord));
+	              });
+
+	// Shapes may span several chunks, gather their segments in file order
+	std::vector<ObjShape> shapes(1);
+
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		for (auto& segment : chunks[c].segments)
+		{
+			if (segment.startsShape)
+			{
+				shapes.push_back({.name = std::move(segment.name)});
+			}
+
+			if (!segment.indices.empty())
+			{
+				shapes.back().segments.push_back({&segment, bases[c]});
+			}
+		}
+	}
+
+	// Like tinyobj, groups without faces do not make a shape
+	std::erase_if(shapes, [](const ObjShape& shape)
+	{
+		return shape.segments.empty();
+	});
+
+	std::vector<WeldedShape> welded(shapes.size());
+
+	std::transform(std::execution::par, shapes.begin(), shapes.end(),
+	               welded.begin(),
+	               [&attributes](const ObjShape& shape)
+	               {
+		               return weldShape(attributes, shape);
+	               });
+
+	if (std::any_of(welded.begin(), welded.end(),
+	                [](const WeldedShape& shape) { return !shape.valid; }))
+	{
+		throw std::runtime_error("Invalid OBJ vertex index");
+	}
+
+	std::vector<ObjRange> ranges;
+	ranges.reserve(shapes.size());
+
+	auto vertexCount = vertices.size();
+	auto indexCount = indices.size();
+
+	for (size_t s = 0; s < shapes.size(); s++)
+	{
+		ranges.push_back({
+			.name = shapes[s].name,
+			.startVertex = static_cast<uint32_t>(vertexCount),
+			.vertexCount = static_cast<uint32_t>(welded[s].vertices.size()),
+			.startIndex = static_cast<uint32_t>(indexCount),
+			.indexCount = static_cast<uint32_t>(welded[s].indices.size()),
+			.hasTexCoords = welded[s].hasTexCoords
+		});
+
+		vertexCount += welded[s].vertices.size();
+		indexCount += welded[s].indices.size();
+	}
+
+	if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX)
+	{
+		throw std::runtime_error("OBJ too large for 32-bit indices");
+	}
+
+	vertices.resize(vertexCount);
+	indices.resize(indexCount);
+
+	std::for_each(std::execution::par, ranges.begin(), ranges.end(),
+	              [&](const ObjRange& range)
+	              {
+		              const auto& shape = welded[&range - ranges.data()];
+
+		              std::copy(shape.vertices.begin(), shape.vertices.end(),
+		                        vertices.begin() + range.startVertex);
+
+		              std::transform(shape.indices.begin(),
+		                             shape.indices.end(),
+		                             indices.begin() + range.startIndex,
+		                             [&range](const uint32_t index)
+		                             {
+			                             return index + range.startVertex;
+		                             });
+	              });
+
+	return ranges;
+}
+
+std::vector<ObjRange> ObjLoader::load(const std::filesystem::path& path,
+                                      std::vector<Vertex>& vertices,
+                                      std::vector<uint32_t>& indices)
+{
+	MappedFile file;
+
+	if (!file.open(path))
+	{
+		throw std::runtime_error("Failed to open obj file " +
+			path.string());
+	}
+
+	return parse(reinterpret_cast<const char*>(file.data()), file.size(),
+	             vertices, indices);
+}
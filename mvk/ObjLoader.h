@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace mvk
+{
+	// Location of a welded shape in the output vertex and index arrays
+	struct ObjRange
+	{
+		std::string name;
+
+		uint32_t startVertex;
+		uint32_t vertexCount;
+		uint32_t startIndex;
+		uint32_t indexCount;
+
+		// True when a corner of the shape references a texcoord
+		bool hasTexCoords;
+	};
+
+	class ObjLoader
+	{
+	public:
+
+		/**
+		 * Parses an OBJ file memory mapped and split in line aligned chunks,
+		 * one per task. Faces are fan triangulated, shapes are split on 'o'
+		 * and 'g' like tinyobj. Materials are ignored.
+		 **/
+		static std::vector<ObjRange> load(const std::filesystem::path& path,
+		                                  std::vector<Vertex>& vertices,
+		                                  std::vector<uint32_t>& indices);
+
+		/**
+		 * Corners are welded while the faces are parsed: corners sharing
+		 * the same position, normal and texcoord indices become one vertex.
+		 * Only the unique corners of each chunk are merged afterwards, with
+		 * the shape they belong to. Shapes are appended to vertices/indices,
+		 * indices are absolute. Shapes without normals get smooth normals.
+		 **/
+		static std::vector<ObjRange> parse(const char* data, size_t size,
+		                                   std::vector<Vertex>& vertices,
+		                                   std::vector<uint32_t>& indices);
+	};
+}
@@ -0,0 +1,231 @@
+#include "ParallelRecorder.h"
+
+#include <algorithm>
+
+using namespace mvk;
+
+void ParallelRecorder::create(Device* device, const uint32_t workerCount)
+{
+	this->ptrDevice = device;
+
+	workers.resize(std::max(workerCount, 1u));
+
+	// Pools are never shared, each is used by one worker at a time
+	const vk::CommandPoolCreateInfo commandPoolCreateInfo = {
+		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		.queueFamilyIndex = device->graphicsQueueFamilyIndex
+	};
+
+	for (auto& worker : workers)
+	{
+		worker.commandPool = device->logicalDevice.createCommandPool(
+			commandPoolCreateInfo);
+	}
+
+	jobQueue = std::make_unique<JobQueue>();
+
+	for (size_t i = 1; i < workers.size(); i++)
+	{
+		jobQueue->threads.emplace_back(runThread, std::ref(*jobQueue));
+	}
+}
+
+void ParallelRecorder::release() const
+{
+	if (jobQueue)
+	{
+		{
+			std::lock_guard lock(jobQueue->mutex);
+			jobQueue->stopping = true;
+		}
+
+		jobQueue->rangeAdded.notify_all();
+
+		for (auto& thread : jobQueue->threads)
+		{
+			thread.join();
+		}
+
+		jobQueue->threads.clear();
+	}
+
+	for (const auto& worker : workers)
+	{
+		// Frees the command buffers with it
+		ptrDevice->logicalDevice.destroyCommandPool(worker.commandPool);
+	}
+}
+
+void ParallelRecorder::createCommandBuffers(const uint32_t slotCount)
+{
+	for (auto& worker : workers)
+	{
+		if (!worker.commandBuffers.empty())
+		{
+			ptrDevice->logicalDevice.freeCommandBuffers(
+				worker.commandPool, worker.commandBuffers);
+		}
+
+		const vk::CommandBufferAllocateInfo commandBufferAllocateInfo{
+			.commandPool = worker.commandPool,
+			.level = vk::CommandBufferLevel::eSecondary,
+			.commandBufferCount = slotCount
+		};
+
+		worker.commandBuffers =
+			ptrDevice->logicalDevice.allocateCommandBuffers(
+				commandBufferAllocateInfo);
+	}
+}
+
+void ParallelRecorder::resetCommandPools() const
+{
+	for (const auto& worker : workers)
+	{
+		ptrDevice->logicalDevice.resetCommandPool(worker.commandPool, {});
+	}
+}
+
+void ParallelRecorder::runThread(JobQueue& queue)
+{
+	std::unique_lock lock(queue.mutex);
+
+	while (true)
+	{
+		queue.rangeAdded.wait(lock, [&queue]
+		{
+			return queue.stopping || !queue.ranges.empty();
+		});
+
+		if (queue.stopping)
+		{
+			return;
+		}
+
+		const auto index = queue.ranges.back();
+		queue.ranges.pop_back();
+
+		lock.unlock();
+
+		std::exception_ptr error;
+
+		try
+		{
+			(*queue.recordRange)(index);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		lock.lock();
+
+		if (error && !queue.error)
+		{
+			queue.error = error;
+		}
+
+		if (--queue.pendingRanges == 0)
+		{
+			queue.rangesDone.notify_all();
+		}
+	}
+}
+
+void ParallelRecorder::record(
+	const vk::CommandBuffer primary, const uint32_t slot,
+	const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+	const uint32_t drawCount, const RecordFunction& recordDraws)
+{
+	const auto workerCount = getWorkerCount();
+	const auto drawsPerWorker = (drawCount + workerCount - 1) / workerCount;
+
+	// Workers past the end of the draw list record nothing
+	const auto usedWorkers = drawsPerWorker == 0
+		                         ? 0
+		                         : (drawCount + drawsPerWorker - 1) /
+		                         drawsPerWorker;
+
+	if (usedWorkers == 0)
+	{
+		return;
+	}
+
+	const vk::CommandBufferBeginInfo beginInfo{
+		.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+		.pInheritanceInfo = &inheritanceInfo
+	};
+
+	const std::function<void(uint32_t)> recordRange = [&](
+		const uint32_t index)
+	{
+		const auto commandBuffer = workers[index].commandBuffers[slot];
+
+		const auto first = index * drawsPerWorker;
+		const auto count = std::min(drawsPerWorker, drawCount - first);
+
+		commandBuffer.begin(beginInfo);
+		recordDraws(commandBuffer, first, count);
+		commandBuffer.end();
+	};
+
+	auto& queue = *jobQueue;
+
+	{
+		std::lock_guard lock(queue.mutex);
+
+		queue.recordRange = &recordRange;
+		queue.error = nullptr;
+		queue.pendingRanges = usedWorkers - 1;
+
+		for (uint32_t index = 1; index < usedWorkers; index++)
+		{
+			queue.ranges.push_back(index);
+		}
+	}
+
+	queue.rangeAdded.notify_all();
+
+	// The calling thread records the first range. Every range is waited
+	// for before an error is rethrown, they reference this frame
+	std::exception_ptr error;
+
+	try
+	{
+		recordRange(0);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	{
+		std::unique_lock lock(queue.mutex);
+
+		queue.rangesDone.wait(lock, [&queue]
+		{
+			return queue.pendingRanges == 0;
+		});
+
+		queue.recordRange = nullptr;
+
+		if (!error)
+		{
+			error = queue.error;
+		}
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+
+	std::vector<vk::CommandBuffer> commandBuffers(usedWorkers);
+
+	for (uint32_t index = 0; index < usedWorkers; index++)
+	{
+		commandBuffers[index] = workers[index].commandBuffers[slot];
+	}
+
+	primary.executeCommands(commandBuffers);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Device.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace mvk
+{
+	/**
+	 * Splits a draw list across worker threads. Every worker owns a command
+	 * pool and a secondary command buffer per slot, it records a contiguous
+	 * range of the draws, and the primary command buffer executes the
+	 * secondaries in draw order. The threads are started once by create
+	 * and take the ranges from a job queue, the calling thread records
+	 * the first one itself.
+	 **/
+	class ParallelRecorder
+	{
+		struct Worker
+		{
+			vk::CommandPool commandPool;
+			// One per slot, such as the swapchain images
+			std::vector<vk::CommandBuffer> commandBuffers;
+		};
+
+		// Behind a pointer so the recorder stays movable
+		struct JobQueue
+		{
+			std::mutex mutex;
+			std::condition_variable rangeAdded;
+			std::condition_variable rangesDone;
+
+			// Indices of the workers whose range is still to be recorded
+			std::vector<uint32_t> ranges;
+			const std::function<void(uint32_t)>* recordRange = nullptr;
+			uint32_t pendingRanges = 0;
+			// First error thrown by a thread since the last record
+			std::exception_ptr error;
+			bool stopping = false;
+
+			std::vector<std::thread> threads;
+		};
+
+		Device* ptrDevice = nullptr;
+		std::vector<Worker> workers;
+		std::unique_ptr<JobQueue> jobQueue;
+
+		static void runThread(JobQueue& queue);
+
+	public:
+
+		// Records the draws [first, first + count) into a secondary
+		using RecordFunction = std::function<void(
+			vk::CommandBuffer commandBuffer, uint32_t first, uint32_t count)>;
+
+		void create(Device* device, uint32_t workerCount);
+		void release() const;
+
+		// Frees the previous command buffers, none may be pending
+		void createCommandBuffers(uint32_t slotCount);
+
+		// None of the command buffers may be pending
+		void resetCommandPools() const;
+
+		uint32_t getWorkerCount() const
+		{
+			return static_cast<uint32_t>(workers.size());
+		}
+
+		bool isCreated() const { return !workers.empty(); }
+
+		/**
+		 * Records drawCount draws on the workers, into the slot's secondary
+		 * command buffers, then executes them from primary. The primary
+		 * must be inside the render pass of the inheritance info, begun
+		 * with vk::SubpassContents::eSecondaryCommandBuffers. An error
+		 * thrown while recording is rethrown once every worker is done.
+		 **/
+		void record(vk::CommandBuffer primary, uint32_t slot,
+		            const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+		            uint32_t drawCount, const RecordFunction& recordDraws);
+	};
+}
@@ -67,6 +67,21 @@ void RenderPass::create(Device* device, const vk::Format colorFormat,
 		.pDepthStencilAttachment = &depthReference
 	};
 
+	// Frames in flight share the multisampled color and depth attachments:
+	// a frame clears them only once the previous one is done writing them
+	const vk::SubpassDependency dependency{
+		.srcSubpass = VK_SUBPASS_EXTERNAL,
+		.dstSubpass = 0,
+		.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
+		vk::PipelineStageFlagBits::eLateFragmentTests,
+		.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
+		vk::PipelineStageFlagBits::eEarlyFragmentTests,
+		.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite |
+		vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+		.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite |
+		vk::AccessFlagBits::eDepthStencilAttachmentWrite
+	};
+
 	const std::array<vk::AttachmentDescription, 3> attachments{
 		colorAttachment,
 		depthAttachment,
@@ -79,7 +94,9 @@ void RenderPass::create(Device* device, const vk::Format colorFormat,
 		.attachmentCount = attachmentCount,
 		.pAttachments = attachments.data(),
 		.subpassCount = 1,
-		.pSubpasses = &subPass
+		.pSubpasses = &subPass,
+		.dependencyCount = 1,
+		.pDependencies = &dependency
 	};
 
 	renderPass = device->logicalDevice.createRenderPass(renderPassCreateInfo);
@@ -0,0 +1,211 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+using namespace mvk;
+
+uint64_t RenderQueue::getId(std::unordered_map<const void*, uint32_t>& ids,
+                            const void* object, const uint32_t bits)
+{
+	const auto [it, inserted] =
+		ids.try_emplace(object, static_cast<uint32_t>(ids.size()));
+
+	return it->second & ((uint64_t{1} << bits) - 1);
+}
+
+uint64_t RenderQueue::makeKey(const DrawPacket& packet)
+{
+	const auto pipeline = getId(pipelineIds, packet.pipeline, 11);
+	const auto material = getId(materialIds, packet.material, 16);
+	const auto mesh = getId(meshIds, packet.model, 12);
+
+	// Positive floats order as their bits do, the top 24 are kept
+	const auto depthBits =
+		std::bit_cast<uint32_t>(std::max(packet.depth, 0.0f)) >> 8;
+
+	if (packet.blended)
+	{
+		const auto farToNear = ~depthBits & 0xFFFFFF;
+
+		return uint64_t{1} << 63 | pipeline << 52 |
+			uint64_t{farToNear} << 28 | material << 12 | mesh;
+	}
+
+	return pipeline << 52 | material << 36 | mesh << 24 | depthBits;
+}
+
+void RenderQueue::clear()
+{
+	packets.clear();
+	keys.clear();
+	order.clear();
+
+	pipelineIds.clear();
+	materialIds.clear();
+	meshIds.clear();
+}
+
+void RenderQueue::push(const DrawPacket& packet)
+{
+	keys.push_back(makeKey(packet));
+	order.push_back(static_cast<uint32_t>(packets.size()));
+	packets.push_back(packet);
+}
+
+void RenderQueue::sort()
+{
+	const auto count = keys.size();
+
+	// Sorted keys follow the order being built, packets stay where they are
+	sortKeys.assign(keys.begin(), keys.end());
+	std::iota(order.begin(), order.end(), 0);
+
+	scratchKeys.resize(count);
+	scratchOrder.resize(count);
+
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		std::array<size_t, 256> offsets{};
+
+		for (const auto key : sortKeys)
+		{
+			offsets[key >> shift & 0xFF]++;
+		}
+
+		// Every key has the same digit, the pass wouldn't move anything
+		if (std::ranges::find(offsets, count) != offsets.end())
+		{
+			continue;
+		}
+
+		std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(),
+		                    size_t{0});
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const auto slot = offsets[sortKeys[i] >> shift & 0xFF]++;
+
+			scratchKeys[slot] = sortKeys[i];
+			scratchOrder[slot] = order[i];
+		}
+
+		sortKeys.swap(scratchKeys);
+		order.swap(scratchOrder);
+	}
+}
+
+void RenderQueue::execute(const vk::CommandBuffer commandBuffer,
+                          const uint32_t first, const uint32_t count) const
+{
+	const GraphicPipeline* boundPipeline = nullptr;
+	vk::PipelineLayout layout;
+
+	std::array<vk::DescriptorSet, DrawPacket::maxDescriptorSets> boundSets{};
+	uint32_t boundSetCount = 0;
+	uint32_t boundDynamicSet = DrawPacket::noDynamicSet;
+	uint32_t boundDynamicOffset = 0;
+
+	const void* boundPushConstants = nullptr;
+	const Model* boundModel = nullptr;
+
+	for (auto i = first; i < first + count; i++)
+	{
+		const auto& packet = packets[order[i]];
+
+		if (packet.pipeline != boundPipeline)
+		{
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+			                           packet.pipeline->getPipeline());
+			boundPipeline = packet.pipeline;
+
+			// Sets and constants may not be compatible with a new layout
+			if (packet.pipeline->getPipelineLayout() != layout)
+			{
+				layout = packet.pipeline->getPipelineLayout();
+				boundSetCount = 0;
+				boundDynamicSet = DrawPacket::noDynamicSet;
+				boundPushConstants = nullptr;
+			}
+		}
+
+		const auto isChanged = [&](const uint32_t set)
+		{
+			const auto dynamicChanged = set == packet.dynamicSet &&
+				(boundDynamicSet != set ||
+					boundDynamicOffset != packet.dynamicOffset);
+
+			return set >= boundSetCount ||
+				boundSets[set] != packet.descriptorSets[set] ||
+				dynamicChanged;
+		};
+
+		// Sets of the same layout stay bound around a rebound one, so only
+		// the runs of changed sets are bound
+		for (uint32_t firstSet = 0; firstSet < packet.descriptorSetCount;)
+		{
+			if (!isChanged(firstSet))
+			{
+				firstSet++;
+				continue;
+			}
+
+			auto endSet = firstSet + 1;
+
+			while (endSet < packet.descriptorSetCount && isChanged(endSet))
+			{
+				endSet++;
+			}
+
+			const auto dynamic = packet.dynamicSet >= firstSet &&
+				packet.dynamicSet < endSet;
+
+			commandBuffer.bindDescriptorSets(
+				vk::PipelineBindPoint::eGraphics, layout, firstSet,
+				endSet - firstSet, packet.descriptorSets.data() + firstSet,
+				dynamic ? 1 : 0, dynamic ? &packet.dynamicOffset : nullptr);
+
+			std::copy(packet.descriptorSets.begin() + firstSet,
+			          packet.descriptorSets.begin() + endSet,
+			          boundSets.begin() + firstSet);
+
+			if (dynamic)
+			{
+				boundDynamicSet = packet.dynamicSet;
+				boundDynamicOffset = packet.dynamicOffset;
+			}
+			else if (boundDynamicSet >= firstSet && boundDynamicSet < endSet)
+			{
+				boundDynamicSet = DrawPacket::noDynamicSet;
+			}
+
+			firstSet = endSet;
+		}
+
+		boundSetCount = std::max(boundSetCount, packet.descriptorSetCount);
+
+		if (packet.pushConstants && packet.pushConstants != boundPushConstants)
+		{
+			commandBuffer.pushConstants(layout, packet.pushConstantStages, 0,
+			                            packet.pushConstantsSize,
+			                            packet.pushConstants);
+			boundPushConstants = packet.pushConstants;
+		}
+
+		if (packet.model != boundModel)
+		{
+			packet.model->bindBuffers(commandBuffer);
+			boundModel = packet.model;
+		}
+
+		if (packet.lod.indexCount > 0)
+		{
+			packet.model->draw(commandBuffer, packet.node, packet.lod);
+		}
+		else
+		{
+			packet.model->draw(commandBuffer, packet.node);
+		}
+	}
+}
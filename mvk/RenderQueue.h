@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Model.h"
+#include "GraphicPipeline.h"
+
+#include <array>
+#include <unordered_map>
+
+namespace mvk
+{
+	// Everything one draw binds, pointers must outlive the execution
+	struct DrawPacket
+	{
+		static constexpr uint32_t maxDescriptorSets = 4;
+		static constexpr uint32_t noDynamicSet = ~0u;
+
+		const GraphicPipeline* pipeline = nullptr;
+		// Groups draws sharing descriptor sets and push constants
+		const void* material = nullptr;
+
+		const Model* model = nullptr;
+		const Node* node = nullptr;
+		// The whole node when the index count is 0
+		MeshLod lod{};
+
+		// Bound from set 0
+		std::array<vk::DescriptorSet, maxDescriptorSets> descriptorSets{};
+		uint32_t descriptorSetCount = 0;
+
+		// Set using a dynamic uniform buffer, such as the model's node set
+		uint32_t dynamicSet = noDynamicSet;
+		uint32_t dynamicOffset = 0;
+
+		// Pushed at offset 0 when not null
+		const void* pushConstants = nullptr;
+		uint32_t pushConstantsSize = 0;
+		vk::ShaderStageFlags pushConstantStages =
+			vk::ShaderStageFlagBits::eFragment;
+
+		// View space depth: opaque draws go front to back, blended draws
+		// after them, back to front
+		float depth = 0.0f;
+		bool blended = false;
+	};
+
+	/**
+	 * Draw packets sorted by a 64 bit key, so that execution only binds
+	 * what changes between consecutive draws. From the most significant
+	 * bit the key holds:
+	 *   opaque:  0 | pipeline:11 | material:16 | mesh:12 | depth:24
+	 *   blended: 1 | pipeline:11 | ~depth:24 | material:16 | mesh:12
+	 * Identifiers are handed out in submission order and wrap around past
+	 * their width, which only costs extra binds.
+	 **/
+	class RenderQueue
+	{
+		std::vector<DrawPacket> packets;
+		// Key of every packet
+		std::vector<uint64_t> keys;
+		// Packet indices, in key order once sorted
+		std::vector<uint32_t> order;
+
+		// Radix sort ping pong buffers
+		std::vector<uint64_t> sortKeys;
+		std::vector<uint64_t> scratchKeys;
+		std::vector<uint32_t> scratchOrder;
+
+		std::unordered_map<const void*, uint32_t> pipelineIds;
+		std::unordered_map<const void*, uint32_t> materialIds;
+		std::unordered_map<const void*, uint32_t> meshIds;
+
+		static uint64_t getId(std::unordered_map<const void*, uint32_t>& ids,
+		                      const void* object, uint32_t bits);
+
+		uint64_t makeKey(const DrawPacket& packet);
+
+	public:
+
+		void clear();
+		void push(const DrawPacket& packet);
+
+		// Least significant digit first, 8 bits per pass. Stable, equal
+		// keys keep their submission order.
+		void sort();
+
+		uint32_t size() const
+		{
+			return static_cast<uint32_t>(packets.size());
+		}
+
+		void execute(const vk::CommandBuffer commandBuffer) const
+		{
+			execute(commandBuffer, 0, size());
+		}
+
+		/**
+		 * Records the sorted draws [first, first + count), binding state
+		 * as if nothing was bound before, so that ranges can be recorded
+		 * into separate command buffers.
+		 **/
+		void execute(vk::CommandBuffer commandBuffer, uint32_t first,
+		             uint32_t count) const;
+	};
+}
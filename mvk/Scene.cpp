@@ -11,21 +11,27 @@ void Scene::setup(Device* device, Skybox* skybox)
 	                          glm::vec3(0.0f, 1.0f, 0.0f));
 
 	createUniformBufferObject();
-	updateUniformBufferObject(0.0f, 0.0f);
+
+	for (uint32_t frame = 0; frame < device->framesInFlight; frame++)
+	{
+		updateUniformBufferObject(frame, 0.0f, 0.0f);
+	}
+
 	createDescriptorSetLayout();
 	createDescriptorPool();
 	createDescriptorSets();
 	updateDescriptorSets();
 }
 
-void Scene::update(const float time, const float deltaTime)
+void Scene::update(const uint32_t frame, const float time,
+                   const float deltaTime)
 {
-	updateUniformBufferObject(time, deltaTime);
+	updateUniformBufferObject(frame, time, deltaTime);
 }
 
-void Scene::release() const
+void Scene::release()
 {
-	ptrDevice->destroyBuffer(uniformBuffer);
+	ptrDevice->uniformRing.release(uniformAllocation);
 	ptrDevice->logicalDevice.destroyDescriptorPool(descriptorPool);
 
 	if (descriptorSetLayout)
@@ -33,7 +39,8 @@ void Scene::release() const
 		         .destroyDescriptorSetLayout(descriptorSetLayout);
 }
 
-void Scene::renderSkybox(const vk::CommandBuffer commandBuffer)
+void Scene::renderSkybox(const vk::CommandBuffer commandBuffer,
+                         const uint32_t frame)
 {
 	if (!skybox)
 	{
@@ -44,7 +51,7 @@ void Scene::renderSkybox(const vk::CommandBuffer commandBuffer)
 	const auto pipelineLayout = skybox->graphicPipeline.getPipelineLayout();
 
 	const std::vector<vk::DescriptorSet> descriptorSets{
-		skybox->getDescriptorSet(0)
+		skybox->getDescriptorSet(frame)
 	};
 
 	const auto descriptorCount =
@@ -69,30 +76,26 @@ void Scene::renderSkybox(const vk::CommandBuffer commandBuffer)
 
 void Scene::createUniformBufferObject()
 {
-	const auto size = sizeof(UniformBufferObject);
-
-	const vk::BufferCreateInfo bufferCreateInfo{
-		.size = static_cast<vk::DeviceSize>(size),
-		.usage = vk::BufferUsageFlagBits::eUniformBuffer,
-	};
-
-	uniformBuffer =
-		alloc::allocateCpuToGpuBuffer(ptrDevice->allocator, bufferCreateInfo);
+	uniformAllocation =
+		ptrDevice->uniformRing.allocate(sizeof(UniformBufferObject));
 }
 
 void Scene::createDescriptorPool()
 {
+	const auto frameCount = ptrDevice->framesInFlight;
+
 	std::vector<vk::DescriptorPoolSize> descriptorPoolSizes{
 		{
 			.type = vk::DescriptorType::eUniformBuffer,
-			.descriptorCount = 1
+			.descriptorCount = frameCount
 		},
 	};
 
 	if (skybox)
 	{
+		// Reflection and irradiance maps
 		descriptorPoolSizes.push_back({
-			vk::DescriptorType::eCombinedImageSampler, 1
+			vk::DescriptorType::eCombinedImageSampler, 2 * frameCount
 		});
 	}
 
@@ -100,7 +103,7 @@ void Scene::createDescriptorPool()
 		static_cast<uint32_t>(descriptorPoolSizes.size());
 
 	const vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{
-		.maxSets = 1,
+		.maxSets = frameCount,
 		.poolSizeCount = poolSizeCount,
 		.pPoolSizes = descriptorPoolSizes.data()
 	};
@@ -111,10 +114,13 @@ void Scene::createDescriptorPool()
 
 void Scene::createDescriptorSets()
 {
+	const std::vector<vk::DescriptorSetLayout> setLayouts(
+		ptrDevice->framesInFlight, descriptorSetLayout);
+
 	const vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{
 		.descriptorPool = descriptorPool,
-		.descriptorSetCount = 1,
-		.pSetLayouts = &descriptorSetLayout
+		.descriptorSetCount = static_cast<uint32_t>(setLayouts.size()),
+		.pSetLayouts = setLayouts.data()
 	};
 
 	descriptorSets = ptrDevice->logicalDevice
@@ -175,11 +181,16 @@ void Scene::createDescriptorSetLayout()
 
 void Scene::updateDescriptorSets()
 {
-	for (const auto& descriptorSet : descriptorSets)
+	for (size_t frame = 0; frame < descriptorSets.size(); frame++)
 	{
+		const auto descriptorSet = descriptorSets[frame];
+
+		const auto& uniformRing = ptrDevice->uniformRing;
+
 		const vk::DescriptorBufferInfo descriptorBufferInfo{
-			.buffer = uniformBuffer.buffer,
-			.offset = 0,
+			.buffer = uniformRing.getBuffer(uniformAllocation),
+			.offset = uniformRing.getOffset(uniformAllocation,
+			                                static_cast<uint32_t>(frame)),
 			.range = sizeof(UniformBufferObject)
 		};
 
@@ -236,7 +247,8 @@ void Scene::updateDescriptorSets()
 	}
 }
 
-void Scene::updateUniformBufferObject(const float time, const float deltaTime)
+void Scene::updateUniformBufferObject(const uint32_t frame, const float time,
+                                      const float deltaTime)
 {
 	UniformBufferObject ubo{};
 
@@ -248,7 +260,9 @@ void Scene::updateUniformBufferObject(const float time, const float deltaTime)
 	ubo.proj[1][1] *= -1;
 	ubo.camPos = camera.position;
 
-	mapDataToBuffer(ptrDevice->allocator, uniformBuffer, &ubo, sizeof ubo);
+	const auto& uniformRing = ptrDevice->uniformRing;
+
+	uniformRing.write(uniformAllocation, frame, &ubo, sizeof ubo);
 
 	if (skybox)
 	{
@@ -260,7 +274,7 @@ void Scene::updateUniformBufferObject(const float time, const float deltaTime)
 		uboS.proj = camera.projMatrix;
 		uboS.proj[1][1] *= -1;
 
-		mapDataToBuffer(ptrDevice->allocator, skybox->uniformBuffer, &uboS,
-		                sizeof uboS);
+		uniformRing.write(skybox->uniformAllocation, frame, &uboS,
+		                  sizeof uboS);
 	}
 }
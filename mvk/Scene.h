@@ -22,7 +22,9 @@ namespace mvk
 	{
 		Device* ptrDevice;
 
-		alloc::Buffer uniformBuffer;
+		// In the device's uniform ring, one copy and one descriptor set
+		// per frame in flight
+		UniformRing::Allocation uniformAllocation;
 		vk::DescriptorPool descriptorPool;
 		std::vector<vk::DescriptorSet> descriptorSets;
 
@@ -31,7 +33,8 @@ namespace mvk
 		void createDescriptorSetLayout();
 		void createUniformBufferObject();
 		void updateDescriptorSets();
-		void updateUniformBufferObject(float time, float deltaTime);
+		void updateUniformBufferObject(uint32_t frame, float time,
+		                               float deltaTime);
 		
 	public:
 
@@ -44,14 +47,16 @@ namespace mvk
 
 		void setup(Device* device, Skybox* skybox = nullptr);
 
-		void update(float time, float deltaTime);
-		void release() const;
+		// Writes the uniform data of the given frame in flight only
+		void update(uint32_t frame, float time, float deltaTime);
+		void release();
 
-		void renderSkybox(vk::CommandBuffer commandBuffer);
+		void renderSkybox(vk::CommandBuffer commandBuffer, uint32_t frame);
 
-		vk::DescriptorSet getDescriptorSet(const int i)
+		// Set of the given frame in flight
+		vk::DescriptorSet getDescriptorSet(const uint32_t frame)
 		{
-			return descriptorSets[i];
+			return descriptorSets[frame];
 		}
 	};
 }
@@ -1,4 +1,5 @@
 #include "Skybox.h"
+#include "UploadBatch.h"
 
 using namespace mvk;
 
@@ -39,15 +40,8 @@ void Skybox::loadCubemap(const vk::Queue transferQueue,
 
 void Skybox::createUniformBufferObject(vk::Queue transferQueue)
 {
-	const auto size = sizeof(UniformBufferObject);
-
-	const vk::BufferCreateInfo bufferCreateInfo{
-		.size = static_cast<vk::DeviceSize>(size),
-		.usage = vk::BufferUsageFlagBits::eUniformBuffer,
-	};
-
-	uniformBuffer =
-		alloc::allocateCpuToGpuBuffer(ptrDevice->allocator, bufferCreateInfo);
+	uniformAllocation =
+		ptrDevice->uniformRing.allocate(sizeof(UniformBufferObject));
 }
 
 void Skybox::createSkyboxVertexBuffer(const vk::Queue transferQueue)
@@ -86,15 +80,15 @@ void Skybox::createSkyboxVertexBuffer(const vk::Queue transferQueue)
 	const auto iSize =
 		static_cast<vk::DeviceSize>(sizeof indices.at(0) * indexCount);
 
-	vertexBuffer = ptrDevice->transferDataSetToGpuBuffer(transferQueue,
-	                                                     vertices.data(), vSize,
-	                                                     vk::BufferUsageFlagBits
-	                                                     ::eVertexBuffer);
+	UploadBatch batch(ptrDevice, transferQueue);
+
+	vertexBuffer = batch.createBuffer(vertices.data(), vSize,
+	                                  vk::BufferUsageFlagBits::eVertexBuffer);
+
+	indexBuffer = batch.createBuffer(indices.data(), iSize,
+	                                 vk::BufferUsageFlagBits::eIndexBuffer);
 
-	indexBuffer = ptrDevice->transferDataSetToGpuBuffer(transferQueue,
-	                                                    indices.data(), iSize,
-	                                                    vk::BufferUsageFlagBits
-	                                                    ::eIndexBuffer);
+	batch.flush();
 }
 
 void Skybox::createDescriptorLayout(Device* device)
@@ -129,20 +123,22 @@ void Skybox::createDescriptorLayout(Device* device)
 
 void Skybox::createDescriptorPool()
 {
+	const auto frameCount = ptrDevice->framesInFlight;
+
 	const std::vector<vk::DescriptorPoolSize> descriptorPoolSizes
 	{
 		{
 			.type = vk::DescriptorType::eUniformBuffer,
-			.descriptorCount = 1
+			.descriptorCount = frameCount
 		},
 		{
 			.type = vk::DescriptorType::eCombinedImageSampler,
-			.descriptorCount = 1
+			.descriptorCount = frameCount
 		}
 	};
 
 	const vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{
-		.maxSets = 1,
+		.maxSets = frameCount,
 		.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size()),
 		.pPoolSizes = descriptorPoolSizes.data()
 	};
@@ -153,10 +149,13 @@ void Skybox::createDescriptorPool()
 
 void Skybox::createDescriptorSets()
 {
+	const std::vector<vk::DescriptorSetLayout> setLayouts(
+		ptrDevice->framesInFlight, descriptorSetLayout);
+
 	const vk::DescriptorSetAllocateInfo allocateInfo{
 		.descriptorPool = descriptorPool,
-		.descriptorSetCount = 1,
-		.pSetLayouts = &descriptorSetLayout
+		.descriptorSetCount = static_cast<uint32_t>(setLayouts.size()),
+		.pSetLayouts = setLayouts.data()
 	};
 
 	descriptorSets =
@@ -165,12 +164,17 @@ void Skybox::createDescriptorSets()
 
 void Skybox::updateDescriptorSets()
 {
-	for (const auto& descriptorSet : descriptorSets)
+	for (size_t frame = 0; frame < descriptorSets.size(); frame++)
 	{
+		const auto descriptorSet = descriptorSets[frame];
+
 		// UBO
+		const auto& uniformRing = ptrDevice->uniformRing;
+
 		const vk::DescriptorBufferInfo bufferInfo{
-			.buffer = uniformBuffer.buffer,
-			.offset = {0},
+			.buffer = uniformRing.getBuffer(uniformAllocation),
+			.offset = uniformRing.getOffset(uniformAllocation,
+			                                static_cast<uint32_t>(frame)),
 			.range = sizeof(UniformBufferObject)
 		};
 
@@ -241,7 +245,7 @@ void Skybox::buildPipeline(const vk::RenderPass renderPass)
 	graphicPipeline.build(ptrDevice, createInfo);
 }
 
-void Skybox::release() const
+void Skybox::release()
 {
 	cubemap.release();
 
@@ -253,7 +257,7 @@ void Skybox::release() const
 	ptrDevice->logicalDevice.destroyDescriptorPool(descriptorPool);
 	ptrDevice->logicalDevice.destroyDescriptorSetLayout(descriptorSetLayout);
 
-	ptrDevice->destroyBuffer(uniformBuffer);
+	ptrDevice->uniformRing.release(uniformAllocation);
 	ptrDevice->destroyBuffer(vertexBuffer);
 	ptrDevice->destroyBuffer(indexBuffer);
 }
@@ -94,7 +94,8 @@ namespace mvk
 
 		GraphicPipeline graphicPipeline;
 
-		alloc::Buffer uniformBuffer;
+		// In the device's uniform ring, written by the scene every frame
+		UniformRing::Allocation uniformAllocation;
 		alloc::Buffer indexBuffer;
 		alloc::Buffer vertexBuffer;
 
@@ -105,11 +106,12 @@ namespace mvk
 		            vk::RenderPass renderPass,
 		            std::array<std::string, 6> texturePaths);
 
-		void release() const;
+		void release();
 
-		vk::DescriptorSet getDescriptorSet(const int index)
+		// Set of the given frame in flight
+		vk::DescriptorSet getDescriptorSet(const uint32_t frame)
 		{
-			return descriptorSets[index];
+			return descriptorSets[frame];
 		}
 
 		static vk::DescriptorSetLayout getDescriptorSetLayout(Device* device)
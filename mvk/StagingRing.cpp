@@ -0,0 +1,101 @@
+#include "StagingRing.h"
+
+using namespace mvk;
+
+void StagingRing::create(const vma::Allocator allocator,
+                         const vk::DeviceSize size)
+{
+	const vk::BufferCreateInfo bufferCreateInfo = {
+		.size = size,
+		.usage = vk::BufferUsageFlagBits::eTransferSrc,
+		.sharingMode = vk::SharingMode::eExclusive
+	};
+
+	const vma::AllocationCreateInfo allocationCreateInfo = {
+		.flags = vma::AllocationCreateFlagBits::eMapped,
+		.usage = vma::MemoryUsage::eCpuToGpu
+	};
+
+	vma::AllocationInfo allocationInfo = {};
+
+	const auto result = allocator.createBuffer(bufferCreateInfo,
+	                                           allocationCreateInfo,
+	                                           allocationInfo);
+
+	buffer = {result.first, result.second};
+	mappedData = static_cast<unsigned char*>(allocationInfo.pMappedData);
+	capacity = size;
+}
+
+void StagingRing::destroy(const vma::Allocator allocator) const
+{
+	alloc::deallocateBuffer(allocator, buffer);
+}
+
+std::optional<StagingRing::Allocation> StagingRing::allocate(
+	const vk::DeviceSize size, const vk::DeviceSize alignment)
+{
+	const auto align = [alignment](const vk::DeviceSize offset)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	};
+
+	std::lock_guard lock(mutex);
+
+	if (ranges.empty())
+	{
+		head = 0;
+	}
+
+	const auto tail = ranges.empty() ? capacity : ranges.front().begin;
+	auto start = align(head);
+
+	// Used space is either [tail, head) or wraps around the end
+	const auto wrapped = !ranges.empty() && head <= tail;
+
+	if (wrapped || ranges.empty())
+	{
+		if (start + size > tail)
+		{
+			return std::nullopt;
+		}
+	}
+	else if (start + size > capacity)
+	{
+		// Skip the end of the ring, the range keeps the skipped bytes
+		start = 0;
+
+		if (size > tail)
+		{
+			return std::nullopt;
+		}
+	}
+
+	ranges.push_back({
+		.begin = head,
+		.end = start + size,
+		.released = false
+	});
+
+	head = start + size;
+
+	return Allocation{
+		.id = firstId + ranges.size() - 1,
+		.buffer = buffer.buffer,
+		.offset = start,
+		.data = mappedData + start
+	};
+}
+
+void StagingRing::release(const Allocation& allocation)
+{
+	std::lock_guard lock(mutex);
+
+	ranges[allocation.id - firstId].released = true;
+
+	while (!ranges.empty() && ranges.front().released)
+	{
+		ranges.pop_front();
+		firstId++;
+	}
+}
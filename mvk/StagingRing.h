@@ -0,0 +1,59 @@
+#pragma once
+
+#include "VulkanVma.h"
+
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace mvk
+{
+	/**
+	 * Persistently mapped upload buffer shared by every loader thread.
+	 * Space is handed out in order around the ring and comes back once the
+	 * oldest allocations are released, so a release only frees memory when
+	 * every allocation made before it has been released too.
+	 **/
+	class StagingRing
+	{
+		struct Range
+		{
+			vk::DeviceSize begin;
+			vk::DeviceSize end;
+			bool released;
+		};
+
+		alloc::Buffer buffer;
+		unsigned char* mappedData = nullptr;
+		vk::DeviceSize capacity = 0;
+
+		std::mutex mutex;
+		vk::DeviceSize head = 0;
+		// Allocations not yet freed, oldest first
+		std::deque<Range> ranges;
+		uint64_t firstId = 0;
+
+	public:
+
+		struct Allocation
+		{
+			uint64_t id;
+			vk::Buffer buffer;
+			vk::DeviceSize offset;
+			unsigned char* data;
+		};
+
+		void create(vma::Allocator allocator, vk::DeviceSize size);
+		void destroy(vma::Allocator allocator) const;
+
+		/**
+		 * Empty when the ring has no room left for size bytes, callers
+		 * then fall back to a buffer of their own.
+		 **/
+		std::optional<Allocation> allocate(vk::DeviceSize size,
+		                                   vk::DeviceSize alignment);
+
+		// The GPU must be done reading the allocation
+		void release(const Allocation& allocation);
+	};
+}
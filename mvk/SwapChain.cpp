@@ -3,14 +3,14 @@
 using namespace mvk;
 
 void SwapChain::create(Device* device,
-                       const vk::Queue transferQueue,
+                       const vk::Queue graphicsQueue,
                        const vk::SurfaceKHR surface)
 {
 	this->ptrDevice = device;
 
 	createSwapChainKHR(surface);
-	createColorImageTarget(transferQueue);
-	createDepthImageTarget(transferQueue);
+	createColorImageTarget(graphicsQueue);
+	createDepthImageTarget(graphicsQueue);
 }
 
 void SwapChain::createSwapChainKHR(const vk::SurfaceKHR surface)
@@ -44,7 +44,7 @@ void SwapChain::createSwapChainKHR(const vk::SurfaceKHR surface)
 		ptrDevice->logicalDevice.createSwapchainKHR(swapchainCreateInfoKhr);
 }
 
-void SwapChain::createColorImageTarget(const vk::Queue transferQueue)
+void SwapChain::createColorImageTarget(const vk::Queue graphicsQueue)
 {
 	const vk::ImageCreateInfo imageCreateInfo{
 		.imageType = vk::ImageType::e2D,
@@ -96,7 +96,7 @@ void SwapChain::createColorImageTarget(const vk::Queue transferQueue)
 		ptrDevice->logicalDevice.createImageView(imageViewCreateInfo);
 }
 
-void SwapChain::createDepthImageTarget(const vk::Queue transferQueue)
+void SwapChain::createDepthImageTarget(const vk::Queue graphicsQueue)
 {
 	depthFormat = vk::Format::eD32Sfloat;
 
@@ -127,7 +127,7 @@ void SwapChain::createDepthImageTarget(const vk::Queue transferQueue)
 		.layerCount = 1
 	};
 
-	ptrDevice->transitionImageLayout(transferQueue, depthImage.image,
+	ptrDevice->transitionImageLayout(graphicsQueue, depthImage.image,
 	                                 vk::ImageLayout::eUndefined,
 	                                 vk::ImageLayout::
 	                                 eDepthStencilAttachmentOptimal,
@@ -156,26 +156,6 @@ void SwapChain::createDepthImageTarget(const vk::Queue transferQueue)
 		ptrDevice->logicalDevice.createImageView(imageViewCreateInfo);
 }
 
-void SwapChain::createCommandBuffers()
-{
-	const vk::CommandBufferAllocateInfo commandBufferAllocateInfo{
-		.commandPool = ptrDevice->commandPool,
-		.level = vk::CommandBufferLevel::ePrimary,
-		.commandBufferCount = static_cast<uint32_t>(size)
-	};
-
-	commandBuffers = ptrDevice->logicalDevice
-	                          .allocateCommandBuffers(
-		                          commandBufferAllocateInfo);
-
-	auto i = 0;
-	for (const auto& commandBuffer : commandBuffers)
-	{
-		swapchainFrames[i].setCommandBuffer(commandBuffer);
-		i++;
-	}
-}
-
 void SwapChain::createSwapchainFrames(const vk::RenderPass renderPass)
 {
 	swapchainFrames.resize(size);
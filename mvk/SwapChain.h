@@ -15,7 +15,6 @@ namespace mvk
 		Device* ptrDevice;
 
 		vk::SwapchainKHR swapchain;
-		std::vector<vk::CommandBuffer> commandBuffers;
 		std::vector<SwapchainFrame> swapchainFrames;
 
 		alloc::Image depthImage;
@@ -29,8 +28,8 @@ namespace mvk
 		vk::Format colorFormat = vk::Format::eUndefined;
 		vk::Format depthFormat = vk::Format::eUndefined;
 
-		void createDepthImageTarget(vk::Queue transferQueue);
-		void createColorImageTarget(vk::Queue transferQueue);
+		void createDepthImageTarget(vk::Queue graphicsQueue);
+		void createColorImageTarget(vk::Queue graphicsQueue);
 
 		SurfaceCapabilitiesKHRBatch getSwapchainCapabilities(
 			vk::PhysicalDevice physicalDevice,
@@ -45,13 +44,11 @@ namespace mvk
 
 	public:
 		void create(Device* device,
-		            vk::Queue transferQueue,
+		            vk::Queue graphicsQueue,
 		            vk::SurfaceKHR surface);
 
 		void createSwapChainKHR(vk::SurfaceKHR surface);
 
-		void createCommandBuffers();
-
 		void createSwapchainFrames(vk::RenderPass renderPass);
 
 		void release() const;
@@ -11,7 +11,6 @@ namespace mvk
 
 		vk::ImageView imageView;
 		vk::Framebuffer framebuffer;
-		vk::CommandBuffer commandBuffer;
 
 		void createImageView(vk::Image image, vk::Format format);
 
@@ -34,11 +33,5 @@ namespace mvk
 
 		vk::ImageView getImageView() const { return imageView; }
 		vk::Framebuffer getFramebuffer() const { return framebuffer; }
-		vk::CommandBuffer getCommandBuffer() const { return commandBuffer; }
-
-		void setCommandBuffer(const vk::CommandBuffer commandBuffer)
-		{
-			this->commandBuffer = commandBuffer;
-		}
 	};
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Device.hpp"
+#include "UploadBatch.h"
 
 namespace mvk
 {
@@ -30,12 +31,15 @@ namespace mvk
 		                                        uint32_t mipLevels,
 		                                        vk::Format format) = 0;
 
-		void generateMipMaps(const vk::Queue transferQueue,
+		/**
+		 * Records the blits, every level must be in transfer dst layout.
+		 * All layers go through each level together, behind one barrier.
+		 **/
+		void generateMipMaps(const vk::CommandBuffer commandBuffer,
 		                     const vk::Image image,
-		                     const uint32_t baseArrayLayer) const
+		                     const uint32_t baseArrayLayer,
+		                     const uint32_t layerCount = 1) const
 		{
-			const auto commandBuffer = ptrDevice->beginOneTimeSubmitCommands();
-
 			int mipWidth = width;
 			int mipHeight = height;
 
@@ -52,7 +56,7 @@ namespace mvk
 						.baseMipLevel = static_cast<uint32_t>(i - 1),
 						.levelCount = 1,
 						.baseArrayLayer = baseArrayLayer,
-						.layerCount = 1
+						.layerCount = layerCount
 					}
 				};
 
@@ -83,7 +87,7 @@ namespace mvk
 						.aspectMask = vk::ImageAspectFlagBits::eColor,
 						.mipLevel = static_cast<uint32_t>(i - 1),
 						.baseArrayLayer = baseArrayLayer,
-						.layerCount = 1
+						.layerCount = layerCount
 					},
 					.srcOffsets = srcOffsets,
 
@@ -91,7 +95,7 @@ namespace mvk
 						.aspectMask = vk::ImageAspectFlagBits::eColor,
 						.mipLevel = static_cast<uint32_t>(i),
 						.baseArrayLayer = baseArrayLayer,
-						.layerCount = 1
+						.layerCount = layerCount
 					},
 					.dstOffsets = dstOffsets
 				};
@@ -120,7 +124,7 @@ namespace mvk
 					.baseMipLevel = 0,
 					.levelCount = mipLevels - 1,
 					.baseArrayLayer = baseArrayLayer,
-					.layerCount = 1
+					.layerCount = layerCount
 				}
 			};
 
@@ -130,8 +134,78 @@ namespace mvk
 			                              vk::DependencyFlagBits::eByRegion,
 			                              0, nullptr, 0, nullptr,
 			                              1, &imageMemoryBarrier);
+		}
+
+		/**
+		 * Records the upload of layerCount RGBA8 layers packed one after
+		 * another in staging with a single copy, then the mips of every
+		 * layer. The image must have been created in the undefined layout.
+		 **/
+		void uploadLayers(UploadBatch& batch,
+		                  const vk::Image image,
+		                  const UploadBatch::Staging& staging,
+		                  const uint32_t layerCount) const
+		{
+			const vk::BufferImageCopy bufferImageCopy{
+				.bufferOffset = 0,
+				.bufferRowLength = 0,
+				.bufferImageHeight = 0,
+				.imageSubresource{
+					.aspectMask = vk::ImageAspectFlagBits::eColor,
+					.mipLevel = 0,
+					.baseArrayLayer = 0,
+					.layerCount = layerCount,
+				},
+				.imageOffset{0, 0},
+				.imageExtent{
+					.width = width,
+					.height = height,
+					.depth = 1
+				},
+			};
+
+			const vk::ImageSubresourceRange subresourceRange{
+				.baseMipLevel = 0,
+				.levelCount = mipLevels,
+				.baseArrayLayer = 0,
+				.layerCount = layerCount
+			};
+
+			batch.transitionImageLayout(image,
+			                            vk::ImageLayout::eUndefined,
+			                            vk::ImageLayout::eTransferDstOptimal,
+			                            subresourceRange);
+
+			batch.copyToImage(staging, image, {&bufferImageCopy, 1});
+
+			if (mipLevels > 1)
+			{
+				generateMipMaps(batch.getCommandBuffer(), image, 0,
+				                layerCount);
+			}
+
+			batch.transitionImageLayout(image,
+			                            vk::ImageLayout::eTransferDstOptimal,
+			                            vk::ImageLayout::eShaderReadOnlyOptimal,
+			                            subresourceRange);
+		}
+
+		// Same from pixels in memory, in a batch of its own
+		void uploadLayers(const vk::Queue transferQueue,
+		                  const vk::Image image,
+		                  const unsigned char* pixels,
+		                  const uint32_t layerCount) const
+		{
+			const auto size = vk::DeviceSize(width) * height * 4 * layerCount;
+
+			UploadBatch batch(ptrDevice, transferQueue);
+
+			const auto staging = batch.allocateStaging(size);
+			memcpy(staging.data, pixels, static_cast<size_t>(size));
+
+			uploadLayers(batch, image, staging, layerCount);
 
-			ptrDevice->endOneTimeSubmitCommands(commandBuffer, transferQueue);
+			batch.flush();
 		}
 
 
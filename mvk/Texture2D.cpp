@@ -1,6 +1,10 @@
 #include "Texture2D.h"
+#include "MappedFile.h"
+#include "UploadBatch.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "../3rdParty/stb_image.h"
+#include <filesystem>
+#include <iostream>
 #include <string>
 
 using namespace mvk;
@@ -10,6 +14,20 @@ void Texture2D::loadFromFile(Device* device,
                              const char* path,
                              const vk::Format format)
 {
+	if (std::filesystem::path(path).extension() == ".ktx2")
+	{
+		MappedFile file;
+
+		if (!file.open(path))
+		{
+			throw std::runtime_error(std::string("Failed to load texture: ") +
+				path);
+		}
+
+		loadFromKtx2(device, transferQueue, {file.data(), file.size()});
+		return;
+	}
+
 	this->ptrDevice = device;
 	this->format = format;
 
@@ -38,6 +56,44 @@ void Texture2D::loadFromFile(Device* device,
 	stbi_image_free(pixels);
 }
 
+void Texture2D::loadFromMemory(Device* device,
+                               const vk::Queue transferQueue,
+                               const unsigned char* data,
+                               const size_t size,
+                               const vk::Format format)
+{
+	if (KtxFile::isKtx2({data, size}))
+	{
+		loadFromKtx2(device, transferQueue, {data, size});
+		return;
+	}
+
+	this->ptrDevice = device;
+	this->format = format;
+
+	int w, h, c;
+	const auto pixels = stbi_load_from_memory(data, static_cast<int>(size),
+	                                          &w, &h, &c, STBI_rgb_alpha);
+
+	if (!pixels)
+	{
+		throw std::runtime_error("Failed to decode embedded texture");
+	}
+
+	width = static_cast<uint32_t>(w);
+	height = static_cast<uint32_t>(h);
+	mipLevels = static_cast<uint32_t>(std::floor(
+		std::log2(std::max(width, height)))) + 1;
+
+	image = copyDataToGpuImage(transferQueue, pixels, width, height, mipLevels,
+	                           format);
+	createImageView();
+	createSampler();
+	createDescriptorInfo();
+
+	stbi_image_free(pixels);
+}
+
 void Texture2D::loadRaw(Device* device, const vk::Queue transferQueue,
                         const unsigned char* pixels, const int w,
                         const int h)
@@ -57,40 +113,87 @@ void Texture2D::loadRaw(Device* device, const vk::Queue transferQueue,
 	createDescriptorInfo();
 }
 
-alloc::Image Texture2D::copyDataToGpuImage(const vk::Queue transferQueue,
-                                           const unsigned char* pixels,
-                                           const uint32_t width,
-                                           const uint32_t height,
-                                           const uint32_t mipLevels,
-                                           const vk::Format format)
+void Texture2D::loadFromKtx2(Device* device, const vk::Queue transferQueue,
+                             const std::span<const unsigned char> data)
 {
-	const vk::DeviceSize imageSize = width * height * 4;
-	const vk::BufferCreateInfo bufferCreateInfo{
-		.size = imageSize,
-		.usage = vk::BufferUsageFlagBits::eTransferSrc
-	};
+	this->ptrDevice = device;
 
-	const auto stagingBuffer =
-		alloc::allocateMappedCpuToGpuBuffer(ptrDevice->allocator,
-		                                    bufferCreateInfo,
-		                                    pixels);
+	const KtxFile file(data);
 
-	const vk::Extent3D imageExtent{
-		.width = width,
-		.height = height,
-		.depth = 1
-	};
+	const auto properties =
+		device->physicalDevice.getFormatProperties(file.getFormat());
+
+	if (!(properties.optimalTilingFeatures
+		& vk::FormatFeatureFlagBits::eSampledImage))
+	{
+		throw std::runtime_error("KTX2 format not supported by the device: "
+			+ vk::to_string(file.getFormat()));
+	}
+
+	format = file.getFormat();
+	width = file.getWidth();
+	height = file.getHeight();
+	mipLevels = static_cast<uint32_t>(file.getLevels().size());
+
+	image = copyLevelsToGpuImage(transferQueue, file);
+
+	createImageView();
+	createSampler();
+	createDescriptorInfo();
+}
+
+void Texture2D::loadCooked(Device* device, const vk::Queue transferQueue,
+                           const char* path, const TextureUsage usage)
+{
+	const auto cookedPath = TextureCooker::getCookedPath(path, usage);
+
+	if (TextureCooker::isUpToDate(path, cookedPath))
+	{
+		loadFromFile(device, transferQueue, cookedPath.string().c_str(),
+		             vk::Format::eUndefined);
+		return;
+	}
+
+	const auto cooked = TextureCooker::cookFile(path, usage);
+
+	if (!TextureCooker::write(cookedPath, cooked))
+	{
+		std::cerr << "Warn: cooked texture not written for " << path
+			<< std::endl;
+	}
+
+	loadFromKtx2(device, transferQueue, cooked);
+}
+
+alloc::Image Texture2D::copyLevelsToGpuImage(const vk::Queue transferQueue,
+                                             const KtxFile& file) const
+{
+	const auto levels = file.getLevels();
+
+	// Levels are stored next to each other, smallest first, they are
+	// staged together straight from the file
+	uint64_t begin = ~0ull;
+	uint64_t end = 0;
+
+	for (const auto& level : levels)
+	{
+		begin = std::min(begin, level.offset);
+		end = std::max(end, level.offset + level.size);
+	}
 
 	const vk::ImageCreateInfo imageCreateInfo{
 		.imageType = vk::ImageType::e2D,
 		.format = format,
-		.extent = imageExtent,
+		.extent = {
+			.width = width,
+			.height = height,
+			.depth = 1
+		},
 		.mipLevels = mipLevels,
 		.arrayLayers = 1,
 		.samples = vk::SampleCountFlagBits::e1,
 		.tiling = vk::ImageTiling::eOptimal,
-		.usage = vk::ImageUsageFlagBits::eTransferSrc |
-		vk::ImageUsageFlagBits::eTransferDst |
+		.usage = vk::ImageUsageFlagBits::eTransferDst |
 		vk::ImageUsageFlagBits::eSampled,
 		.sharingMode = vk::SharingMode::eExclusive,
 		.initialLayout = vk::ImageLayout::eUndefined,
@@ -99,19 +202,29 @@ alloc::Image Texture2D::copyDataToGpuImage(const vk::Queue transferQueue,
 	const auto imageBuffer = alloc::allocateGpuOnlyImage(ptrDevice->allocator,
 	                                                     imageCreateInfo);
 
-	const vk::BufferImageCopy bufferImageCopy{
-		.bufferOffset = 0,
-		.bufferRowLength = 0,
-		.bufferImageHeight = 0,
-		.imageSubresource{
-			.aspectMask = vk::ImageAspectFlagBits::eColor,
-			.mipLevel = 0,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
-		},
-		.imageOffset{0, 0},
-		.imageExtent = imageExtent,
-	};
+	std::vector<vk::BufferImageCopy> bufferImageCopies;
+	bufferImageCopies.reserve(levels.size());
+
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		bufferImageCopies.push_back({
+			.bufferOffset = levels[i].offset - begin,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource{
+				.aspectMask = vk::ImageAspectFlagBits::eColor,
+				.mipLevel = i,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.imageOffset{0, 0},
+			.imageExtent{
+				.width = levels[i].width,
+				.height = levels[i].height,
+				.depth = 1
+			},
+		});
+	}
 
 	const vk::ImageSubresourceRange subresourceRange{
 		.baseMipLevel = 0,
@@ -120,27 +233,58 @@ alloc::Image Texture2D::copyDataToGpuImage(const vk::Queue transferQueue,
 		.layerCount = 1
 	};
 
-	ptrDevice->transitionImageLayout(transferQueue, imageBuffer.image,
-	                                 vk::ImageLayout::eUndefined,
-	                                 vk::ImageLayout::eTransferDstOptimal,
-	                                 subresourceRange);
+	UploadBatch batch(ptrDevice, transferQueue);
 
-	ptrDevice->copyCpuBufferToGpuImage(transferQueue, stagingBuffer,
-	                                   imageBuffer,
-	                                   bufferImageCopy);
+	batch.transitionImageLayout(imageBuffer.image,
+	                            vk::ImageLayout::eUndefined,
+	                            vk::ImageLayout::eTransferDstOptimal,
+	                            subresourceRange);
 
-	if (mipLevels > 1)
-	{
-		generateMipMaps(transferQueue, imageBuffer.image, 0);
-	}
+	batch.copyToImage(file.getData().data() + begin, end - begin,
+	                  imageBuffer.image, bufferImageCopies);
+
+	batch.transitionImageLayout(imageBuffer.image,
+	                            vk::ImageLayout::eTransferDstOptimal,
+	                            vk::ImageLayout::eShaderReadOnlyOptimal,
+	                            subresourceRange);
+
+	batch.flush();
+
+	return imageBuffer;
+}
 
-	ptrDevice->transitionImageLayout(transferQueue, imageBuffer.image,
-	                                 vk::ImageLayout::eTransferDstOptimal,
-	                                 vk::ImageLayout::eShaderReadOnlyOptimal,
-	                                 subresourceRange);
+alloc::Image Texture2D::copyDataToGpuImage(const vk::Queue transferQueue,
+                                           const unsigned char* pixels,
+                                           const uint32_t width,
+                                           const uint32_t height,
+                                           const uint32_t mipLevels,
+                                           const vk::Format format)
+{
+	const vk::Extent3D imageExtent{
+		.width = width,
+		.height = height,
+		.depth = 1
+	};
+
+	const vk::ImageCreateInfo imageCreateInfo{
+		.imageType = vk::ImageType::e2D,
+		.format = format,
+		.extent = imageExtent,
+		.mipLevels = mipLevels,
+		.arrayLayers = 1,
+		.samples = vk::SampleCountFlagBits::e1,
+		.tiling = vk::ImageTiling::eOptimal,
+		.usage = vk::ImageUsageFlagBits::eTransferSrc |
+		vk::ImageUsageFlagBits::eTransferDst |
+		vk::ImageUsageFlagBits::eSampled,
+		.sharingMode = vk::SharingMode::eExclusive,
+		.initialLayout = vk::ImageLayout::eUndefined,
+	};
 
+	const auto imageBuffer = alloc::allocateGpuOnlyImage(ptrDevice->allocator,
+	                                                     imageCreateInfo);
 
-	alloc::deallocateBuffer(ptrDevice->allocator, stagingBuffer);
+	uploadLayers(transferQueue, imageBuffer.image, pixels, 1);
 
 	return imageBuffer;
 }
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "Texture.hpp"
+#include "KtxFile.h"
+#include "TextureCooker.h"
+
+#include <span>
 
 namespace mvk
 {
@@ -13,6 +17,10 @@ namespace mvk
 		                                uint32_t mipLevels,
 		                                vk::Format format) override;
 
+		// Uploads the stored levels as they are, nothing is generated
+		alloc::Image copyLevelsToGpuImage(vk::Queue transferQueue,
+		                                  const KtxFile& file) const;
+
 		void createImageView() override;
 		void createSampler() override;
 		void createDescriptorInfo() override;
@@ -29,6 +37,29 @@ namespace mvk
 		                  const char* path,
 		                  vk::Format format);
 
+		// Decodes an encoded image file (png, jpg, ktx2...) held in memory
+		void loadFromMemory(Device* device,
+		                    vk::Queue transferQueue,
+		                    const unsigned char* data,
+		                    size_t size,
+		                    vk::Format format);
+
+		/**
+		 * Loads a KTX2 file in its own format, block compressed formats
+		 * included, with the mip chain it stores. Throws when the file is
+		 * supercompressed or the device cannot sample its format.
+		 **/
+		void loadFromKtx2(Device* device, vk::Queue transferQueue,
+		                  std::span<const unsigned char> data);
+
+		/**
+		 * Loads the cooked version of an image file, block compressed with
+		 * its whole mip chain. The image is cooked first if its cooked file
+		 * is missing or older than it.
+		 **/
+		void loadCooked(Device* device, vk::Queue transferQueue,
+		                const char* path, TextureUsage usage);
+
 		inline static Texture2D* empty;
 	};
 }
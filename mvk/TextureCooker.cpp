@@ -0,0 +1,775 @@
+#include "TextureCooker.h"
+#include "Vulkan.h"
+
+#include "../3rdParty/stb_image.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <execution>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+using namespace mvk;
+
+namespace
+{
+	// Mip level in floating point, colors in linear space, normals in -1..1
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<glm::vec4> texels;
+	};
+
+	using Pixel = std::array<uint8_t, 4>;
+
+	float srgbToLinear(const uint8_t value)
+	{
+		static const auto table = []
+		{
+			std::array<float, 256> values{};
+
+			for (size_t i = 0; i < values.size(); i++)
+			{
+				const auto c = static_cast<float>(i) / 255.0f;
+
+				values[i] = c <= 0.04045f
+					            ? c / 12.92f
+					            : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+
+			return values;
+		}();
+
+		return table[value];
+	}
+
+	uint8_t linearToSrgb(const float value)
+	{
+		const auto c = std::clamp(value, 0.0f, 1.0f);
+
+		const auto srgb = c <= 0.0031308f
+			                  ? c * 12.92f
+			                  : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+
+		return static_cast<uint8_t>(srgb * 255.0f + 0.5f);
+	}
+
+	uint8_t toUnorm8(const float value)
+	{
+		return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f
+			+ 0.5f);
+	}
+
+	Level toLevel(const unsigned char* pixels, const uint32_t width,
+	              const uint32_t height, const TextureUsage usage)
+	{
+		Level level{width, height, std::vector<glm::vec4>(width * height)};
+
+		std::transform(std::execution::par,
+		               reinterpret_cast<const Pixel*>(pixels),
+		               reinterpret_cast<const Pixel*>(pixels)
+		               + level.texels.size(),
+		               level.texels.begin(),
+		               [usage](const Pixel& pixel)
+		               {
+			               const auto value = glm::vec4(
+				               pixel[0], pixel[1], pixel[2], pixel[3])
+				               / 255.0f;
+
+			               switch (usage)
+			               {
+			               case TextureUsage::eColor:
+				               return glm::vec4(srgbToLinear(pixel[0]),
+				                                srgbToLinear(pixel[1]),
+				                                srgbToLinear(pixel[2]),
+				                                value.w);
+			               case TextureUsage::eNormal:
+				               return value * 2.0f - 1.0f;
+			               default:
+				               return value;
+			               }
+		               });
+
+		return level;
+	}
+
+	// 2x2 box filter, odd edges are clamped
+	Level downsample(const Level& source, const TextureUsage usage)
+	{
+		Level level{
+			std::max(source.width / 2, 1u),
+			std::max(source.height / 2, 1u),
+			{}
+		};
+
+		level.texels.resize(level.width * level.height);
+
+		std::vector<uint32_t> rows(level.height);
+		std::iota(rows.begin(), rows.end(), 0u);
+
+		std::for_each(std::execution::par, rows.begin(), rows.end(),
+		              [&](const uint32_t y)
+		              {
+			              const auto y0 = std::min(y * 2, source.height - 1);
+			              const auto y1 = std::min(y * 2 + 1, source.height - 1);
+
+			              for (uint32_t x = 0; x < level.width; x++)
+			              {
+				              const auto x0 = std::min(x * 2, source.width - 1);
+				              const auto x1 = std::min(x * 2 + 1,
+				                                       source.width - 1);
+
+				              auto texel = (source.texels[y0 * source.width + x0]
+					              + source.texels[y0 * source.width + x1]
+					              + source.texels[y1 * source.width + x0]
+					              + source.texels[y1 * source.width + x1])
+					              * 0.25f;
+
+				              if (usage == TextureUsage::eNormal)
+				              {
+					              const auto length = glm::length(
+						              glm::vec3(texel));
+
+					              texel = length > 0.0f
+						                      ? glm::vec4(
+							                      glm::vec3(texel) / length,
+							                      texel.w)
+						                      : glm::vec4(0, 0, 1, texel.w);
+				              }
+
+				              level.texels[y * level.width + x] = texel;
+			              }
+		              });
+
+		return level;
+	}
+
+	Pixel toPixel(const glm::vec4& texel, const TextureUsage usage)
+	{
+		switch (usage)
+		{
+		case TextureUsage::eColor:
+			return {
+				linearToSrgb(texel.x), linearToSrgb(texel.y),
+				linearToSrgb(texel.z), toUnorm8(texel.w)
+			};
+		case TextureUsage::eNormal:
+			return {
+				toUnorm8(texel.x * 0.5f + 0.5f),
+				toUnorm8(texel.y * 0.5f + 0.5f),
+				toUnorm8(texel.z * 0.5f + 0.5f),
+				toUnorm8(texel.w)
+			};
+		default:
+			return {
+				toUnorm8(texel.x), toUnorm8(texel.y), toUnorm8(texel.z),
+				toUnorm8(texel.w)
+			};
+		}
+	}
+
+	// Little endian bit writer for a single block
+	class BlockWriter
+	{
+		uint8_t* block;
+		uint32_t bit = 0;
+
+	public:
+
+		explicit BlockWriter(uint8_t* block) : block(block) {}
+
+		void write(const uint32_t value, const uint32_t bitCount)
+		{
+			for (uint32_t i = 0; i < bitCount; i++, bit++)
+			{
+				block[bit / 8] |= ((value >> i) & 1) << (bit % 8);
+			}
+		}
+	};
+
+	/**
+	 * BC4 block in its eight value mode, the endpoints are the block's
+	 * extremes.
+	 **/
+	void encodeBc4Block(const std::array<uint8_t, 16>& values, uint8_t* block)
+	{
+		const auto [minimum, maximum] =
+			std::minmax_element(values.begin(), values.end());
+
+		const auto r0 = *maximum;
+		const auto r1 = *minimum;
+
+		std::array<float, 8> palette{
+			static_cast<float>(r0), static_cast<float>(r1)
+		};
+
+		for (uint32_t i = 2; i < 8; i++)
+		{
+			palette[i] = ((8.0f - i) * r0 + (i - 1.0f) * r1) / 7.0f;
+		}
+
+		memset(block, 0, 8);
+
+		BlockWriter writer(block);
+		writer.write(r0, 8);
+		writer.write(r1, 8);
+
+		for (const auto value : values)
+		{
+			uint32_t best = 0;
+			auto bestError = std::abs(palette[0] - value);
+
+			for (uint32_t i = 1; i < 8 && r0 != r1; i++)
+			{
+				const auto error = std::abs(palette[i] - value);
+
+				if (error < bestError)
+				{
+					best = i;
+					bestError = error;
+				}
+			}
+
+			writer.write(best, 3);
+		}
+	}
+
+	constexpr std::array<uint32_t, 16> bc7Weights = {
+		0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+	};
+
+	// Endpoint quantized to 7 bits per channel plus a shared p-bit
+	struct Bc7Endpoint
+	{
+		std::array<uint32_t, 4> value;
+		uint32_t pBit;
+
+		glm::vec4 get() const
+		{
+			return glm::vec4(value[0] << 1 | pBit, value[1] << 1 | pBit,
+			                 value[2] << 1 | pBit, value[3] << 1 | pBit);
+		}
+	};
+
+	Bc7Endpoint quantizeBc7Endpoint(const glm::vec4& endpoint)
+	{
+		Bc7Endpoint best{};
+		auto bestError = std::numeric_limits<float>::max();
+
+		for (uint32_t pBit = 0; pBit < 2; pBit++)
+		{
+			Bc7Endpoint quantized{.pBit = pBit};
+
+			for (auto c = 0; c < 4; c++)
+			{
+				const auto value = std::round((endpoint[c] - pBit) / 2.0f);
+				quantized.value[c] = static_cast<uint32_t>(
+					std::clamp(value, 0.0f, 127.0f));
+			}
+
+			const auto difference = quantized.get() - endpoint;
+			const auto error = glm::dot(difference, difference);
+
+			if (error < bestError)
+			{
+				best = quantized;
+				bestError = error;
+			}
+		}
+
+		return best;
+	}
+
+	// Picks the closest palette entry of every pixel, returns the error
+	float assignBc7Indices(const std::array<glm::vec4, 16>& pixels,
+	                       const Bc7Endpoint& e0, const Bc7Endpoint& e1,
+	                       std::array<uint32_t, 16>& indices)
+	{
+		std::array<glm::vec4, 16> palette;
+
+		const auto v0 = e0.get();
+		const auto v1 = e1.get();
+
+		for (size_t i = 0; i < palette.size(); i++)
+		{
+			const auto w = static_cast<float>(bc7Weights[i]);
+			palette[i] = glm::floor(((64.0f - w) * v0 + w * v1 + 32.0f)
+				/ 64.0f);
+		}
+
+		auto totalError = 0.0f;
+
+		for (size_t p = 0; p < pixels.size(); p++)
+		{
+			auto bestError = std::numeric_limits<float>::max();
+
+			for (uint32_t i = 0; i < palette.size(); i++)
+			{
+				const auto difference = palette[i] - pixels[p];
+				const auto error = glm::dot(difference, difference);
+
+				if (error < bestError)
+				{
+					indices[p] = i;
+					bestError = error;
+				}
+			}
+
+			totalError += bestError;
+		}
+
+		return totalError;
+	}
+
+	/**
+	 * BC7 mode 6: a single RGBA line with 4 bit indices. Endpoints start at
+	 * the extremes along the principal axis and are refined once with a
+	 * least squares fit to the chosen indices.
+	 **/
+	void encodeBc7Block(const std::array<Pixel, 16>& block, uint8_t* out)
+	{
+		std::array<glm::vec4, 16> pixels;
+		glm::vec4 mean(0.0f);
+
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			pixels[i] = glm::vec4(block[i][0], block[i][1], block[i][2],
+			                      block[i][3]);
+			mean += pixels[i];
+		}
+
+		mean /= 16.0f;
+
+		glm::mat4 covariance(0.0f);
+		glm::vec4 minimum(255.0f);
+		glm::vec4 maximum(0.0f);
+
+		for (const auto& pixel : pixels)
+		{
+			const auto d = pixel - mean;
+			covariance += glm::outerProduct(d, d);
+			minimum = glm::min(minimum, pixel);
+			maximum = glm::max(maximum, pixel);
+		}
+
+		// Power iteration for the principal axis
+		auto axis = maximum - minimum;
+
+		for (auto i = 0; i < 8; i++)
+		{
+			axis = covariance * axis;
+
+			const auto length = glm::length(axis);
+
+			if (length < 1e-6f)
+			{
+				break;
+			}
+
+			axis /= length;
+		}
+
+		auto tMin = 0.0f;
+		auto tMax = 0.0f;
+
+		for (const auto& pixel : pixels)
+		{
+			const auto t = glm::dot(pixel - mean, axis);
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+
+		auto e0 = quantizeBc7Endpoint(
+			glm::clamp(mean + axis * tMin, 0.0f, 255.0f));
+		auto e1 = quantizeBc7Endpoint(
+			glm::clamp(mean + axis * tMax, 0.0f, 255.0f));
+
+		std::array<uint32_t, 16> indices{};
+		auto error = assignBc7Indices(pixels, e0, e1, indices);
+
+		// Least squares endpoints for the chosen weights
+		auto aa = 0.0f;
+		auto ab = 0.0f;
+		auto bb = 0.0f;
+		glm::vec4 ap(0.0f);
+		glm::vec4 bp(0.0f);
+
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			const auto b = static_cast<float>(bc7Weights[indices[i]]) / 64.0f;
+			const auto a = 1.0f - b;
+
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			ap += a * pixels[i];
+			bp += b * pixels[i];
+		}
+
+		const auto determinant = aa * bb - ab * ab;
+
+		if (std::abs(determinant) > 1e-6f)
+		{
+			const auto refined0 = quantizeBc7Endpoint(glm::clamp(
+				(ap * bb - bp * ab) / determinant, 0.0f, 255.0f));
+			const auto refined1 = quantizeBc7Endpoint(glm::clamp(
+				(bp * aa - ap * ab) / determinant, 0.0f, 255.0f));
+
+			std::array<uint32_t, 16> refinedIndices{};
+			const auto refinedError = assignBc7Indices(
+				pixels, refined0, refined1, refinedIndices);
+
+			if (refinedError < error)
+			{
+				e0 = refined0;
+				e1 = refined1;
+				indices = refinedIndices;
+			}
+		}
+
+		// The first index is stored without its top bit
+		if (indices[0] >= 8)
+		{
+			std::swap(e0, e1);
+
+			for (auto& index : indices)
+			{
+				index = 15 - index;
+			}
+		}
+
+		memset(out, 0, 16);
+
+		BlockWriter writer(out);
+		writer.write(1 << 6, 7);
+
+		for (auto c = 0; c < 4; c++)
+		{
+			writer.write(e0.value[c], 7);
+			writer.write(e1.value[c], 7);
+		}
+
+		writer.write(e0.pBit, 1);
+		writer.write(e1.pBit, 1);
+
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			writer.write(indices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	struct BlockFormat
+	{
+		vk::Format format;
+		uint32_t blockSize;
+		// KTX data format descriptor color model
+		uint32_t colorModel;
+		uint32_t sampleCount;
+		// KTX data format descriptor transfer function, linear by default
+		uint32_t transfer = 1;
+	};
+
+	BlockFormat getBlockFormat(const TextureUsage usage)
+	{
+		switch (usage)
+		{
+		case TextureUsage::eNormal:
+			return {vk::Format::eBc5UnormBlock, 16, 132, 2};
+		case TextureUsage::eMask:
+			return {vk::Format::eBc4UnormBlock, 8, 131, 1};
+		case TextureUsage::eColor:
+			// Decoded to linear by the sampler, before filtering
+			return {vk::Format::eBc7SrgbBlock, 16, 134, 1, 2};
+		default:
+			return {vk::Format::eBc7UnormBlock, 16, 134, 1};
+		}
+	}
+
+	std::vector<unsigned char> encodeLevel(const Level& level,
+	                                       const TextureUsage usage)
+	{
+		const auto blockFormat = getBlockFormat(usage);
+		const auto blocksX = (level.width + 3) / 4;
+		const auto blocksY = (level.height + 3) / 4;
+
+		std::vector<unsigned char> data(
+			static_cast<size_t>(blocksX) * blocksY * blockFormat.blockSize);
+
+		std::vector<uint32_t> rows(blocksY);
+		std::iota(rows.begin(), rows.end(), 0u);
+
+		std::for_each(std::execution::par, rows.begin(), rows.end(),
+		              [&](const uint32_t by)
+		              {
+			              for (uint32_t bx = 0; bx < blocksX; bx++)
+			              {
+				              // Texels past the edge repeat the last ones
+				              std::array<Pixel, 16> block;
+
+				              for (uint32_t i = 0; i < 16; i++)
+				              {
+					              const auto x = std::min(bx * 4 + i % 4,
+					                                      level.width - 1);
+					              const auto y = std::min(by * 4 + i / 4,
+					                                      level.height - 1);
+
+					              block[i] = toPixel(
+						              level.texels[y * level.width + x], usage);
+				              }
+
+				              const auto out = data.data()
+					              + (static_cast<size_t>(by) * blocksX + bx)
+					              * blockFormat.blockSize;
+
+				              std::array<uint8_t, 16> channel;
+
+				              switch (usage)
+				              {
+				              case TextureUsage::eNormal:
+					              for (auto c = 0; c < 2; c++)
+					              {
+						              for (auto i = 0; i < 16; i++)
+						              {
+							              channel[i] = block[i][c];
+						              }
+
+						              encodeBc4Block(channel, out + c * 8);
+					              }
+					              break;
+				              case TextureUsage::eMask:
+					              for (auto i = 0; i < 16; i++)
+					              {
+						              channel[i] = block[i][0];
+					              }
+
+					              encodeBc4Block(channel, out);
+					              break;
+				              default:
+					              encodeBc7Block(block, out);
+				              }
+			              }
+		              });
+
+		return data;
+	}
+
+	template <typename T>
+	void append(std::vector<unsigned char>& data, const T value)
+	{
+		const auto bytes = reinterpret_cast<const unsigned char*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof value);
+	}
+
+	// KTX2 file without supercompression, levels stored smallest first
+	std::vector<unsigned char> writeKtx2(
+		const BlockFormat& blockFormat, const uint32_t width,
+		const uint32_t height, const std::vector<std::vector<unsigned char>>&
+		levels)
+	{
+		constexpr unsigned char identifier[12] = {
+			0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+		};
+
+		const auto levelCount = static_cast<uint32_t>(levels.size());
+
+		// Basic data format descriptor: one sample per compressed channel
+		const auto descriptorBlockSize = 24 + 16 * blockFormat.sampleCount;
+		const auto dfdOffset = 80 + 24 * levelCount;
+		const auto dfdSize = 4 + descriptorBlockSize;
+
+		std::vector<unsigned char> data(identifier,
+		                                identifier + sizeof identifier);
+
+		append<uint32_t>(data, static_cast<uint32_t>(blockFormat.format));
+		append<uint32_t>(data, 1); // typeSize
+		append<uint32_t>(data, width);
+		append<uint32_t>(data, height);
+		append<uint32_t>(data, 0); // pixelDepth
+		append<uint32_t>(data, 0); // layerCount
+		append<uint32_t>(data, 1); // faceCount
+		append<uint32_t>(data, levelCount);
+		append<uint32_t>(data, 0); // supercompressionScheme
+
+		append<uint32_t>(data, dfdOffset);
+		append<uint32_t>(data, dfdSize);
+		append<uint32_t>(data, 0); // kvdByteOffset
+		append<uint32_t>(data, 0); // kvdByteLength
+		append<uint64_t>(data, 0); // sgdByteOffset
+		append<uint64_t>(data, 0); // sgdByteLength
+
+		// Levels follow the descriptor, aligned to the block size
+		std::vector<uint64_t> offsets(levelCount);
+		auto offset = static_cast<uint64_t>(dfdOffset + dfdSize);
+
+		for (auto i = levelCount; i-- > 0;)
+		{
+			offset = (offset + blockFormat.blockSize - 1)
+				/ blockFormat.blockSize * blockFormat.blockSize;
+			offsets[i] = offset;
+			offset += levels[i].size();
+		}
+
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			append<uint64_t>(data, offsets[i]);
+			append<uint64_t>(data, levels[i].size());
+			append<uint64_t>(data, levels[i].size());
+		}
+
+		append<uint32_t>(data, dfdSize);
+		append<uint32_t>(data, 0); // vendorId, descriptorType
+		append<uint32_t>(data, 2 | descriptorBlockSize << 16);
+		// Color model, BT.709 primaries, transfer function, no flags
+		append<uint32_t>(data, blockFormat.colorModel | 1 << 8
+		                 | blockFormat.transfer << 16);
+		append<uint32_t>(data, 3 | 3 << 8); // 4x4 texel blocks
+		append<uint32_t>(data, blockFormat.blockSize); // bytesPlane0
+		append<uint32_t>(data, 0);
+
+		const auto sampleBits = blockFormat.blockSize * 8
+			/ blockFormat.sampleCount;
+
+		for (uint32_t s = 0; s < blockFormat.sampleCount; s++)
+		{
+			append<uint32_t>(data, s * sampleBits | (sampleBits - 1) << 16
+			                 | s << 24);
+			append<uint32_t>(data, 0); // samplePosition
+			append<uint32_t>(data, 0); // sampleLower
+			append<uint32_t>(data, ~0u); // sampleUpper
+		}
+
+		for (auto i = levelCount; i-- > 0;)
+		{
+			data.resize(offsets[i]);
+			data.insert(data.end(), levels[i].begin(), levels[i].end());
+		}
+
+		return data;
+	}
+}
+
+fs::path TextureCooker::getCookedPath(const fs::path& source,
+                                      const TextureUsage usage)
+{
+	auto path = source;
+
+	switch (usage)
+	{
+	case TextureUsage::eNormal:
+		path += ".bc5.ktx2";
+		break;
+	case TextureUsage::eMask:
+		path += ".bc4.ktx2";
+		break;
+	case TextureUsage::eLinear:
+		path += ".bc7.ktx2";
+		break;
+	default:
+		path += ".srgb.bc7.ktx2";
+	}
+
+	return path;
+}
+
+bool TextureCooker::isUpToDate(const fs::path& source, const fs::path& cooked)
+{
+	std::error_code error;
+
+	const auto sourceTime = fs::last_write_time(source, error);
+
+	if (error)
+	{
+		return false;
+	}
+
+	const auto cookedTime = fs::last_write_time(cooked, error);
+
+	return !error && cookedTime >= sourceTime;
+}
+
+std::vector<unsigned char> TextureCooker::cook(const unsigned char* pixels,
+                                               const uint32_t width,
+                                               const uint32_t height,
+                                               const TextureUsage usage)
+{
+	std::vector<Level> levels;
+	levels.push_back(toLevel(pixels, width, height, usage));
+
+	while (levels.back().width > 1 || levels.back().height > 1)
+	{
+		levels.push_back(downsample(levels.back(), usage));
+	}
+
+	std::vector<std::vector<unsigned char>> encoded(levels.size());
+
+	std::transform(std::execution::par, levels.begin(), levels.end(),
+	               encoded.begin(),
+	               [usage](const Level& level)
+	               {
+		               return encodeLevel(level, usage);
+	               });
+
+	return writeKtx2(getBlockFormat(usage), width, height, encoded);
+}
+
+std::vector<unsigned char> TextureCooker::cookFile(const fs::path& source,
+                                                   const TextureUsage usage)
+{
+	int w, h, c;
+	const auto pixels = stbi_load(source.string().c_str(), &w, &h, &c,
+	                              STBI_rgb_alpha);
+
+	if (!pixels)
+	{
+		throw std::runtime_error("Failed to load texture: "
+			+ source.string());
+	}
+
+	auto cooked = cook(pixels, static_cast<uint32_t>(w),
+	                   static_cast<uint32_t>(h), usage);
+
+	stbi_image_free(pixels);
+
+	return cooked;
+}
+
+bool TextureCooker::write(const fs::path& cooked,
+                          const std::vector<unsigned char>& data)
+{
+	// Write to a temporary file first so that a reader never maps a
+	// partially written file
+	auto temporaryPath = cooked;
+	temporaryPath += ".tmp";
+
+	{
+		std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+
+		if (!stream)
+		{
+			return false;
+		}
+
+		stream.write(reinterpret_cast<const char*>(data.data()),
+		             static_cast<std::streamsize>(data.size()));
+
+		if (!stream)
+		{
+			stream.close();
+			fs::remove(temporaryPath);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	fs::rename(temporaryPath, cooked, error);
+
+	return !error;
+}
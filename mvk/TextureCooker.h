@@ -0,0 +1,51 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+namespace mvk
+{
+	// What a texture holds, it decides how it is filtered and encoded
+	enum class TextureUsage : uint32_t
+	{
+		// sRGB color, filtered in linear space, BC7
+		eColor,
+		// Linear data such as metallic roughness, BC7
+		eLinear,
+		// Tangent space normals, renormalized at every level, BC5 (xy)
+		eNormal,
+		// Single channel, BC4 (r)
+		eMask
+	};
+
+	/**
+	 * Builds the full mip chain of an image on the CPU and block compresses
+	 * every level, on all cores. The result is a KTX2 file that
+	 * Texture2D::loadFromKtx2 uploads as it is. Cooked files are stored
+	 * next to their source and rebuilt when the source is newer.
+	 **/
+	class TextureCooker
+	{
+	public:
+
+		static std::filesystem::path getCookedPath(
+			const std::filesystem::path& source, TextureUsage usage);
+
+		// True when the cooked file exists and is not older than source
+		static bool isUpToDate(const std::filesystem::path& source,
+		                       const std::filesystem::path& cooked);
+
+		// Encodes RGBA8 pixels into a KTX2 file
+		static std::vector<unsigned char> cook(const unsigned char* pixels,
+		                                       uint32_t width,
+		                                       uint32_t height,
+		                                       TextureUsage usage);
+
+		// Decodes an image file and cooks it, throws if it cannot be decoded
+		static std::vector<unsigned char> cookFile(
+			const std::filesystem::path& source, TextureUsage usage);
+
+		static bool write(const std::filesystem::path& cooked,
+		                  const std::vector<unsigned char>& data);
+	};
+}
@@ -0,0 +1,126 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define MVK_TRANSFORM_SSE
+#endif
+
+using namespace mvk;
+
+uint32_t TransformHierarchy::add(const int32_t parent,
+                                 const glm::mat4& localMatrix)
+{
+	const auto index = size();
+
+	if (parent >= static_cast<int32_t>(index))
+	{
+		throw std::invalid_argument("A parent transform must come first");
+	}
+
+	parents.push_back(parent);
+	localMatrices.push_back(localMatrix);
+	worldMatrices.push_back(localMatrix);
+	dirty.push_back(1);
+
+	firstDirty = std::min(firstDirty, static_cast<size_t>(index));
+
+	return index;
+}
+
+void TransformHierarchy::clear()
+{
+	parents.clear();
+	localMatrices.clear();
+	worldMatrices.clear();
+	dirty.clear();
+	updated.clear();
+	firstDirty = 0;
+}
+
+void TransformHierarchy::setLocalMatrix(const uint32_t index,
+                                        const glm::mat4& localMatrix)
+{
+	localMatrices[index] = localMatrix;
+	dirty[index] = 1;
+
+	firstDirty = std::min(firstDirty, static_cast<size_t>(index));
+}
+
+std::span<const uint32_t> TransformHierarchy::update()
+{
+	updated.clear();
+
+	// Parents come first: when a transform is reached its parent's flag
+	// already tells whether the parent moved in this pass
+	for (auto i = firstDirty; i < parents.size(); i++)
+	{
+		const auto parent = parents[i];
+
+		if (parent != noParent && dirty[parent])
+		{
+			dirty[i] = 1;
+		}
+
+		if (!dirty[i])
+		{
+			continue;
+		}
+
+		if (parent == noParent)
+		{
+			worldMatrices[i] = localMatrices[i];
+		}
+		else
+		{
+			multiply(worldMatrices[parent], localMatrices[i],
+			         worldMatrices[i]);
+		}
+
+		updated.push_back(static_cast<uint32_t>(i));
+	}
+
+	for (const auto index : updated)
+	{
+		dirty[index] = 0;
+	}
+
+	firstDirty = parents.size();
+
+	return updated;
+}
+
+void TransformHierarchy::multiply(const glm::mat4& a, const glm::mat4& b,
+                                  glm::mat4& result)
+{
+#ifdef MVK_TRANSFORM_SSE
+	// Column j of the result is a's columns weighted by column j of b
+	const auto a0 = _mm_loadu_ps(&a[0][0]);
+	const auto a1 = _mm_loadu_ps(&a[1][0]);
+	const auto a2 = _mm_loadu_ps(&a[2][0]);
+	const auto a3 = _mm_loadu_ps(&a[3][0]);
+
+	for (auto j = 0; j < 4; j++)
+	{
+		const auto column = _mm_loadu_ps(&b[j][0]);
+
+		auto sum = _mm_mul_ps(
+			a0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(
+			                 a1, _mm_shuffle_ps(column, column,
+			                                    _MM_SHUFFLE(1, 1, 1, 1))));
+		sum = _mm_add_ps(sum, _mm_mul_ps(
+			                 a2, _mm_shuffle_ps(column, column,
+			                                    _MM_SHUFFLE(2, 2, 2, 2))));
+		sum = _mm_add_ps(sum, _mm_mul_ps(
+			                 a3, _mm_shuffle_ps(column, column,
+			                                    _MM_SHUFFLE(3, 3, 3, 3))));
+
+		_mm_storeu_ps(&result[j][0], sum);
+	}
+#else
+	result = a * b;
+#endif
+}
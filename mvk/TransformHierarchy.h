@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <span>
+#include <vector>
+
+namespace mvk
+{
+	/**
+	 * Local and world matrices of a scene graph, stored as contiguous
+	 * arrays in parent before child order. Changing a local matrix marks
+	 * it dirty; update then recomputes the world matrices of the dirty
+	 * transforms and of their descendants only, in a single forward pass.
+	 **/
+	class TransformHierarchy
+	{
+		// -1 for roots, always lower than the child's own index
+		std::vector<int32_t> parents;
+		std::vector<glm::mat4> localMatrices;
+		std::vector<glm::mat4> worldMatrices;
+		// Local matrix changed, or world matrix recomputed by the last update
+		std::vector<uint8_t> dirty;
+		std::vector<uint32_t> updated;
+
+		// Nothing before it is dirty
+		size_t firstDirty = 0;
+
+	public:
+
+		static constexpr int32_t noParent = -1;
+
+		// The parent must have been added before, returns the index
+		uint32_t add(int32_t parent, const glm::mat4& localMatrix);
+
+		void clear();
+
+		void setLocalMatrix(uint32_t index, const glm::mat4& localMatrix);
+
+		const glm::mat4& getLocalMatrix(const uint32_t index) const
+		{
+			return localMatrices[index];
+		}
+
+		// As of the last update
+		const glm::mat4& getWorldMatrix(const uint32_t index) const
+		{
+			return worldMatrices[index];
+		}
+
+		int32_t getParent(const uint32_t index) const
+		{
+			return parents[index];
+		}
+
+		uint32_t size() const
+		{
+			return static_cast<uint32_t>(parents.size());
+		}
+
+		// Returns the transforms whose world matrix changed
+		std::span<const uint32_t> update();
+
+		// a * b, four columns at a time when SSE is available
+		static void multiply(const glm::mat4& a, const glm::mat4& b,
+		                     glm::mat4& result);
+	};
+}
@@ -0,0 +1,162 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+using namespace mvk;
+
+namespace
+{
+	// Memory a flush of the allocation applies to
+	vma::Allocation getMemory(const UniformRing::Allocation& allocation,
+	                          const alloc::Buffer& ring)
+	{
+		return allocation.dedicated.buffer
+			       ? allocation.dedicated.allocation
+			       : ring.allocation;
+	}
+}
+
+void UniformRing::create(const vma::Allocator allocator,
+                         const vk::DeviceSize regionSize,
+                         const vk::DeviceSize alignment,
+                         const uint32_t frameCount)
+{
+	this->allocator = allocator;
+	this->alignment = std::max(alignment, vk::DeviceSize{1});
+	this->frameCount = frameCount;
+
+	// Every region starts aligned
+	this->regionSize = (regionSize + this->alignment - 1) / this->alignment *
+		this->alignment;
+
+	const vk::BufferCreateInfo bufferCreateInfo = {
+		.size = this->regionSize * frameCount,
+		.usage = vk::BufferUsageFlagBits::eUniformBuffer,
+		.sharingMode = vk::SharingMode::eExclusive
+	};
+
+	const vma::AllocationCreateInfo allocationCreateInfo = {
+		.flags = vma::AllocationCreateFlagBits::eMapped,
+		.usage = vma::MemoryUsage::eCpuToGpu
+	};
+
+	vma::AllocationInfo allocationInfo = {};
+
+	const auto result = allocator.createBuffer(bufferCreateInfo,
+	                                           allocationCreateInfo,
+	                                           allocationInfo);
+
+	buffer = {result.first, result.second};
+	mappedData = static_cast<unsigned char*>(allocationInfo.pMappedData);
+}
+
+void UniformRing::destroy() const
+{
+	alloc::deallocateBuffer(allocator, buffer);
+}
+
+UniformRing::Allocation UniformRing::allocate(const vk::DeviceSize size)
+{
+	const auto align = [this](const vk::DeviceSize offset)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	};
+
+	{
+		std::lock_guard lock(mutex);
+
+		// First gap between live allocations wide enough
+		vk::DeviceSize start = 0;
+
+		for (const auto& [offset, allocationSize] : allocations)
+		{
+			if (start + size <= offset)
+			{
+				break;
+			}
+
+			start = align(offset + allocationSize);
+		}
+
+		if (start + size <= regionSize)
+		{
+			allocations.emplace(start, size);
+
+			return {
+				.offset = start,
+				.size = size,
+				.frameStride = regionSize
+			};
+		}
+	}
+
+	std::cerr << "Warn: uniform ring full, dedicated buffer of " << size
+		<< " bytes per frame" << std::endl;
+
+	const auto frameStride = align(size);
+
+	const vk::BufferCreateInfo bufferCreateInfo = {
+		.size = frameStride * frameCount,
+		.usage = vk::BufferUsageFlagBits::eUniformBuffer,
+		.sharingMode = vk::SharingMode::eExclusive
+	};
+
+	const vma::AllocationCreateInfo allocationCreateInfo = {
+		.flags = vma::AllocationCreateFlagBits::eMapped,
+		.usage = vma::MemoryUsage::eCpuToGpu
+	};
+
+	vma::AllocationInfo allocationInfo = {};
+
+	const auto result = allocator.createBuffer(bufferCreateInfo,
+	                                           allocationCreateInfo,
+	                                           allocationInfo);
+
+	return {
+		.size = size,
+		.frameStride = frameStride,
+		.dedicated = {result.first, result.second},
+		.dedicatedData = static_cast<unsigned char*>(
+			allocationInfo.pMappedData)
+	};
+}
+
+void UniformRing::release(Allocation& allocation)
+{
+	if (!allocation.isValid())
+	{
+		return;
+	}
+
+	if (allocation.dedicated.buffer)
+	{
+		alloc::deallocateBuffer(allocator, allocation.dedicated);
+	}
+	else
+	{
+		std::lock_guard lock(mutex);
+		allocations.erase(allocation.offset);
+	}
+
+	allocation = {};
+}
+
+void UniformRing::write(const Allocation& allocation, const uint32_t frame,
+                        const void* data, const vk::DeviceSize size,
+                        const vk::DeviceSize offset) const
+{
+	memcpy(getData(allocation, frame) + offset, data,
+	       static_cast<size_t>(size));
+
+	allocator.flushAllocation(getMemory(allocation, buffer),
+	                          getOffset(allocation, frame) + offset, size);
+}
+
+void UniformRing::flush(const Allocation& allocation,
+                        const uint32_t frame) const
+{
+	allocator.flushAllocation(getMemory(allocation, buffer),
+	                          getOffset(allocation, frame), allocation.size);
+}
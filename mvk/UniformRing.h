@@ -0,0 +1,93 @@
+#pragma once
+
+#include "VulkanVma.h"
+
+#include <map>
+#include <mutex>
+
+namespace mvk
+{
+	/**
+	 * Persistently mapped uniform buffer holding one region per frame in
+	 * flight. An allocation reserves the same aligned range in every
+	 * region, so a frame writes its own copy while the GPU still reads the
+	 * copies of the frames before it, and offsets stay valid for command
+	 * buffers recorded once. When the ring has no room left, the
+	 * allocation gets a dedicated buffer laid out the same way.
+	 **/
+	class UniformRing
+	{
+		vma::Allocator allocator;
+		alloc::Buffer buffer;
+		unsigned char* mappedData = nullptr;
+
+		vk::DeviceSize regionSize = 0;
+		vk::DeviceSize alignment = 1;
+		uint32_t frameCount = 0;
+
+		std::mutex mutex;
+		// Size of every live allocation, by offset
+		std::map<vk::DeviceSize, vk::DeviceSize> allocations;
+
+	public:
+
+		struct Allocation
+		{
+			vk::DeviceSize offset = 0;
+			vk::DeviceSize size = 0;
+			// Distance between the copies of two frames
+			vk::DeviceSize frameStride = 0;
+
+			// Set when the ring was full, offset is 0 then
+			alloc::Buffer dedicated;
+			unsigned char* dedicatedData = nullptr;
+
+			bool isValid() const { return size > 0; }
+		};
+
+		// Alignment is minUniformBufferOffsetAlignment
+		void create(vma::Allocator allocator, vk::DeviceSize regionSize,
+		            vk::DeviceSize alignment, uint32_t frameCount);
+		void destroy() const;
+
+		// Falls back to a dedicated buffer when no region has room left
+		Allocation allocate(vk::DeviceSize size);
+
+		// No frame using the allocation may still be in flight. Invalid
+		// allocations are ignored, the released one is reset
+		void release(Allocation& allocation);
+
+		// Ring buffer, or the allocation's dedicated buffer
+		vk::Buffer getBuffer(const Allocation& allocation) const
+		{
+			return allocation.dedicated.buffer
+				       ? allocation.dedicated.buffer
+				       : buffer.buffer;
+		}
+
+		// Multiple of the alignment, usable as a dynamic offset
+		vk::DeviceSize getOffset(const Allocation& allocation,
+		                         const uint32_t frame) const
+		{
+			return allocation.frameStride * frame + allocation.offset;
+		}
+
+		unsigned char* getData(const Allocation& allocation,
+		                       const uint32_t frame) const
+		{
+			const auto data = allocation.dedicatedData
+				                  ? allocation.dedicatedData
+				                  : mappedData;
+
+			return data + getOffset(allocation, frame);
+		}
+
+		// Copies into the frame's copy of the allocation, at offset
+		void write(const Allocation& allocation, uint32_t frame,
+		           const void* data, vk::DeviceSize size,
+		           vk::DeviceSize offset = 0) const;
+
+		// Makes writes through getData visible, when memory isn't coherent
+		void flush(const Allocation& allocation, uint32_t frame) const;
+	};
+}
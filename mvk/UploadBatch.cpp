@@ -0,0 +1,273 @@
+#include "UploadBatch.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace mvk;
+
+UploadBatch::UploadBatch(Device* device, const vk::Queue queue)
+	: ptrDevice(device), queue(queue),
+	  separated(device->getQueueFamilyIndex(queue)
+		  != device->graphicsQueueFamilyIndex)
+{
+}
+
+UploadBatch::~UploadBatch()
+{
+	try
+	{
+		flush();
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+	}
+}
+
+vk::CommandBuffer UploadBatch::getTransferCommandBuffer()
+{
+	if (!commandBuffer)
+	{
+		commandBuffer = ptrDevice->beginOneTimeSubmitCommands(queue);
+	}
+
+	return commandBuffer;
+}
+
+vk::CommandBuffer UploadBatch::getCommandBuffer()
+{
+	if (!separated)
+	{
+		return getTransferCommandBuffer();
+	}
+
+	if (!graphicsCommandBuffer)
+	{
+		graphicsCommandBuffer = ptrDevice->beginOneTimeSubmitCommands(
+			ptrDevice->acquireQueue);
+	}
+
+	return graphicsCommandBuffer;
+}
+
+UploadBatch::Staging UploadBatch::allocateStaging(
+	const vk::DeviceSize size, const vk::DeviceSize alignment)
+{
+	if (const auto allocation = ptrDevice->stagingRing.allocate(
+		size, alignment))
+	{
+		ringAllocations.push_back(*allocation);
+
+		return {allocation->buffer, allocation->offset, allocation->data};
+	}
+
+	void* mappedData = nullptr;
+
+	const auto buffer = alloc::allocateMappedStagingBuffer(
+		ptrDevice->allocator, size, mappedData);
+
+	stagingBuffers.push_back(buffer);
+
+	return {buffer.buffer, 0, static_cast<unsigned char*>(mappedData)};
+}
+
+void UploadBatch::copyToBuffer(const void* data, const vk::DeviceSize size,
+                               const vk::Buffer dst,
+                               const vk::DeviceSize dstOffset)
+{
+	const auto staging = allocateStaging(size, 4);
+	memcpy(staging.data, data, static_cast<size_t>(size));
+
+	const vk::BufferCopy bufferCopy = {
+		.srcOffset = staging.offset,
+		.dstOffset = dstOffset,
+		.size = size
+	};
+
+	getTransferCommandBuffer().copyBuffer(staging.buffer, dst, 1,
+	                                      &bufferCopy);
+
+	if (separated)
+	{
+		bufferTransfers.push_back({
+			.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+			.srcQueueFamilyIndex = ptrDevice->transferQueueFamilyIndex,
+			.dstQueueFamilyIndex = ptrDevice->graphicsQueueFamilyIndex,
+			.buffer = dst,
+			.offset = dstOffset,
+			.size = size
+		});
+	}
+}
+
+alloc::Buffer UploadBatch::createBuffer(const void* data,
+                                        const vk::DeviceSize size,
+                                        const vk::BufferUsageFlagBits usage)
+{
+	const auto buffer = alloc::createGpuBufferDst(ptrDevice->allocator, size,
+	                                              usage);
+
+	copyToBuffer(data, size, buffer.buffer);
+
+	return buffer;
+}
+
+void UploadBatch::copyToImage(const void* data, const vk::DeviceSize size,
+                              const vk::Image image,
+                              const std::span<const vk::BufferImageCopy>
+                              regions)
+{
+	// Offsets must stay multiples of the texel block size
+	const auto staging = allocateStaging(size, 16);
+	memcpy(staging.data, data, static_cast<size_t>(size));
+
+	copyToImage(staging, image, regions);
+}
+
+void UploadBatch::copyToImage(const Staging& staging, const vk::Image image,
+                              const std::span<const vk::BufferImageCopy>
+                              regions)
+{
+	std::vector<vk::BufferImageCopy> stagedRegions(regions.begin(),
+	                                               regions.end());
+
+	for (auto& region : stagedRegions)
+	{
+		region.bufferOffset += staging.offset;
+	}
+
+	getTransferCommandBuffer().copyBufferToImage(
+		staging.buffer, image, vk::ImageLayout::eTransferDstOptimal,
+		stagedRegions);
+}
+
+void UploadBatch::transitionImageLayout(const vk::Image image,
+                                        const vk::ImageLayout oldLayout,
+                                        const vk::ImageLayout newLayout,
+                                        const vk::ImageSubresourceRange&
+                                        subresourceRange)
+{
+	const auto beforeCopies = oldLayout == vk::ImageLayout::eUndefined
+		&& newLayout == vk::ImageLayout::eTransferDstOptimal;
+
+	if (!separated || !beforeCopies)
+	{
+		Device::recordImageLayoutTransition(getCommandBuffer(), image,
+		                                    oldLayout, newLayout,
+		                                    subresourceRange);
+		return;
+	}
+
+	Device::recordImageLayoutTransition(getTransferCommandBuffer(), image,
+	                                    oldLayout, newLayout,
+	                                    subresourceRange);
+
+	// Handed over as it is, the graphics queue changes its layout
+	imageTransfers.push_back({
+		.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+		.oldLayout = newLayout,
+		.newLayout = newLayout,
+		.srcQueueFamilyIndex = ptrDevice->transferQueueFamilyIndex,
+		.dstQueueFamilyIndex = ptrDevice->graphicsQueueFamilyIndex,
+		.image = image,
+		.subresourceRange = subresourceRange
+	});
+
+	imageTransfers.back().subresourceRange.aspectMask =
+		vk::ImageAspectFlagBits::eColor;
+}
+
+vk::CommandBuffer UploadBatch::recordOwnershipTransfers(
+	const vk::CommandBuffer transferCommands)
+{
+	transferCommands.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+	                              vk::PipelineStageFlagBits::eBottomOfPipe,
+	                              {}, {}, bufferTransfers, imageTransfers);
+
+	// Matching acquire barriers, what they make visible is then read or
+	// written by anything recorded in graphicsCommandBuffer or later
+	for (auto& barrier : bufferTransfers)
+	{
+		barrier.srcAccessMask = {};
+		barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead
+			| vk::AccessFlagBits::eMemoryWrite;
+	}
+
+	for (auto& barrier : imageTransfers)
+	{
+		barrier.srcAccessMask = {};
+		barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead
+			| vk::AccessFlagBits::eMemoryWrite;
+	}
+
+	const auto acquireCommandBuffer = ptrDevice->beginOneTimeSubmitCommands(
+		ptrDevice->acquireQueue);
+
+	acquireCommandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eAllCommands,
+		vk::PipelineStageFlagBits::eAllCommands,
+		{}, {}, bufferTransfers, imageTransfers);
+
+	bufferTransfers.clear();
+	imageTransfers.clear();
+
+	return acquireCommandBuffer;
+}
+
+void UploadBatch::releaseStaging()
+{
+	for (const auto& allocation : ringAllocations)
+	{
+		ptrDevice->stagingRing.release(allocation);
+	}
+
+	for (const auto& buffer : stagingBuffers)
+	{
+		alloc::deallocateBuffer(ptrDevice->allocator, buffer);
+	}
+
+	ringAllocations.clear();
+	stagingBuffers.clear();
+}
+
+void UploadBatch::flush()
+{
+	const auto transferCommands = commandBuffer;
+	const auto graphicsCommands = graphicsCommandBuffer;
+	commandBuffer = nullptr;
+	graphicsCommandBuffer = nullptr;
+
+	if (!transferCommands)
+	{
+		if (graphicsCommands)
+		{
+			ptrDevice->endOneTimeSubmitCommands(graphicsCommands,
+			                                    ptrDevice->acquireQueue);
+		}
+
+		// Staging memory allocated but never copied from
+		releaseStaging();
+		return;
+	}
+
+	if (!separated)
+	{
+		ptrDevice->endOneTimeSubmitCommands(transferCommands, queue);
+		releaseStaging();
+		return;
+	}
+
+	// Acquire first, then the caller's graphics commands
+	std::vector<vk::CommandBuffer> acquireCommands = {
+		recordOwnershipTransfers(transferCommands)
+	};
+
+	if (graphicsCommands)
+	{
+		acquireCommands.push_back(graphicsCommands);
+	}
+
+	ptrDevice->endOneTimeSubmitCommands(transferCommands, acquireCommands);
+
+	releaseStaging();
+}
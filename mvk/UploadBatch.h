@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Device.hpp"
+
+#include <span>
+#include <vector>
+
+namespace mvk
+{
+	/**
+	 * Records uploads and layout transitions into a single command buffer,
+	 * submitted once by flush. Data is staged in the device's staging ring,
+	 * or in a buffer of its own when the ring is full.
+	 *
+	 * On a separated transfer family, copies run on the transfer queue and
+	 * everything needing a graphics queue runs on the device's acquire
+	 * queue after them. Destinations are released by the transfer family
+	 * and acquired by the graphics one, buffers as a whole copy range,
+	 * images as the range transitioned from the undefined layout.
+	 **/
+	class UploadBatch
+	{
+		Device* ptrDevice;
+		vk::Queue queue;
+		bool separated;
+
+		// Submitted to queue
+		vk::CommandBuffer commandBuffer;
+		// Submitted to the acquire queue, separated families only
+		vk::CommandBuffer graphicsCommandBuffer;
+
+		// Queue family ownership transfers, as release barriers
+		std::vector<vk::BufferMemoryBarrier> bufferTransfers;
+		std::vector<vk::ImageMemoryBarrier> imageTransfers;
+
+		std::vector<StagingRing::Allocation> ringAllocations;
+		std::vector<alloc::Buffer> stagingBuffers;
+
+		vk::CommandBuffer getTransferCommandBuffer();
+
+		// Records the release barriers, returns the acquiring commands
+		vk::CommandBuffer recordOwnershipTransfers(
+			vk::CommandBuffer transferCommands);
+
+		void releaseStaging();
+
+	public:
+
+		struct Staging
+		{
+			vk::Buffer buffer;
+			vk::DeviceSize offset;
+			unsigned char* data;
+		};
+
+		UploadBatch(Device* device, vk::Queue queue);
+		UploadBatch(const UploadBatch&) = delete;
+		UploadBatch& operator=(const UploadBatch&) = delete;
+
+		// Flushes what is left
+		~UploadBatch();
+
+		/**
+		 * Graphics capable, for commands of the caller's own such as mip
+		 * generation. On separated families they run after every copy.
+		 **/
+		vk::CommandBuffer getCommandBuffer();
+
+		/**
+		 * Mapped memory for the caller to fill, from any thread, before the
+		 * batch is flushed. Offsets are multiples of alignment.
+		 **/
+		Staging allocateStaging(vk::DeviceSize size,
+		                        vk::DeviceSize alignment = 16);
+
+		void copyToBuffer(const void* data, vk::DeviceSize size,
+		                  vk::Buffer dst, vk::DeviceSize dstOffset = 0);
+
+		// GPU only buffer holding a copy of data
+		alloc::Buffer createBuffer(const void* data, vk::DeviceSize size,
+		                           vk::BufferUsageFlagBits usage);
+
+		/**
+		 * Region buffer offsets are relative to data. The image must be in
+		 * the transfer destination layout.
+		 **/
+		void copyToImage(const void* data, vk::DeviceSize size,
+		                 vk::Image image,
+		                 std::span<const vk::BufferImageCopy> regions);
+
+		// Region buffer offsets are relative to staging.data
+		void copyToImage(const Staging& staging, vk::Image image,
+		                 std::span<const vk::BufferImageCopy> regions);
+
+		// On separated families, transitions from the undefined layout run
+		// before the copies and the others along with getCommandBuffer
+		void transitionImageLayout(vk::Image image,
+		                           vk::ImageLayout oldLayout,
+		                           vk::ImageLayout newLayout,
+		                           const vk::ImageSubresourceRange&
+		                           subresourceRange);
+
+		// Submits everything recorded and waits for it on a fence
+		void flush();
+	};
+}
@@ -1,11 +1,20 @@
 #pragma once
 
 #include "Vulkan.h"
-#include <glm/vec2.hpp>
-#include <glm/vec3.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <array>
 
 namespace mvk
 {
+	// Layout of the vertices a model uploads
+	enum class VertexFormat : uint32_t
+	{
+		eFull, // Vertex
+		ePacked // PackedVertex
+	};
+
 	struct Vertex
 	{
 		glm::vec3 position; // location = 0
@@ -13,61 +22,93 @@ namespace mvk
 		glm::vec3 normal; // 2 
 		glm::vec2 texCoord; // 3
 		glm::vec2 texCoord1; // 4
+	};
+
+	/**
+	 * Attribute encodings of VertexFormat::ePacked, 24 bytes per vertex
+	 * against 52 for Vertex when every attribute is kept. Positions are 16
+	 * bits normalized per axis inside the node's bounding box and
+	 * dequantized with the node's positionOffset and positionScale, colors
+	 * are 8 bits per channel, normals are octahedral encoded and texture
+	 * coordinates are half floats. VertexLayout.hpp lays them out.
+	 **/
+	struct PackedVertex
+	{
+		using Position = std::array<uint16_t, 4>; // w is padding
+		using Color = std::array<uint8_t, 4>; // a is padding
+		using Normal = std::array<int16_t, 2>;
+		using TexCoord = std::array<uint16_t, 2>;
 
-		static vk::VertexInputBindingDescription getBindingDescription()
+		static Position packPosition(const glm::vec3& position,
+		                             const glm::vec3& offset,
+		                             const glm::vec3& scale)
 		{
-			vk::VertexInputBindingDescription vertexInputBindingDescription{
-				.binding = 0,
-				.stride = sizeof(Vertex),
-				.inputRate = vk::VertexInputRate::eVertex
-			};
+			const auto normalized = glm::clamp(
+				(position - offset) / scale, 0.0f, 1.0f);
+
+			Position packed{};
+
+			for (auto c = 0; c < 3; c++)
+			{
+				packed[c] =
+					static_cast<uint16_t>(normalized[c] * 65535.0f + 0.5f);
+			}
+
+			return packed;
+		}
+
+		static Color packColor(const glm::vec3& color)
+		{
+			Color packed{};
+
+			for (auto c = 0; c < 3; c++)
+			{
+				packed[c] = static_cast<uint8_t>(
+					glm::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
 
-			return vertexInputBindingDescription;
+			packed[3] = 255;
+
+			return packed;
 		}
 
-		static std::vector<vk::VertexInputAttributeDescription>
-		getAttributeDescriptions()
+		static Normal packNormal(const glm::vec3& normal)
 		{
-			std::vector<vk::VertexInputAttributeDescription>
-				vertexInputAttributeDescriptions = {
-					// Position
-					{
-						.location = 0,
-						.binding = 0,
-						.format = vk::Format::eR32G32B32Sfloat,
-						.offset = offsetof(Vertex, position)
-					},
-					// Vertex Color
-					{
-						.location = 1,
-						.binding = 0,
-						.format = vk::Format::eR32G32B32Sfloat,
-						.offset = offsetof(Vertex, color)
-					},
-					// Normal
-					{
-						.location = 2,
-						.binding = 0,
-						.format = vk::Format::eR32G32B32Sfloat,
-						.offset = offsetof(Vertex, normal)
-					},
-					// UV0
-					{
-						.location = 3,
-						.binding = 0,
-						.format = vk::Format::eR32G32Sfloat,
-						.offset = offsetof(Vertex, texCoord)
-					},
-					// UV0
-					{
-						.location = 4,
-						.binding = 0,
-						.format = vk::Format::eR32G32Sfloat,
-						.offset = offsetof(Vertex, texCoord1)
-					}
-				};
-
-			return vertexInputAttributeDescriptions;
+			// Project on the octahedron, the lower half is folded over
+			const auto length =
+				std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+
+			auto octahedral = length > 0.0f
+				                  ? glm::vec2(normal.x, normal.y) / length
+				                  : glm::vec2(0.0f);
+
+			if (normal.z < 0.0f)
+			{
+				octahedral = (1.0f - glm::abs(glm::vec2(octahedral.y,
+				                                        octahedral.x)))
+					* glm::vec2(octahedral.x >= 0.0f ? 1.0f : -1.0f,
+					            octahedral.y >= 0.0f ? 1.0f : -1.0f);
+			}
+
+			Normal packed{};
+
+			for (auto c = 0; c < 2; c++)
+			{
+				packed[c] = static_cast<int16_t>(
+					std::round(glm::clamp(octahedral[c], -1.0f, 1.0f)
+						* 32767.0f));
+			}
+
+			return packed;
+		}
+
+		static TexCoord packTexCoord(const glm::vec2& texCoord)
+		{
+			return {
+				glm::packHalf1x16(texCoord.x),
+				glm::packHalf1x16(texCoord.y)
+			};
 		}
 	};
+
 }
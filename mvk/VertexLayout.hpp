@@ -0,0 +1,448 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <execution>
+#include <functional>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace mvk
+{
+	// Vertex attributes, valued by their shader input location
+	enum class VertexAttribute : uint32_t
+	{
+		ePosition = 0,
+		eColor = 1,
+		eNormal = 2,
+		eTexCoord0 = 3,
+		eTexCoord1 = 4
+	};
+
+	using VertexAttributeMask = uint32_t;
+
+	constexpr VertexAttributeMask toMask(const VertexAttribute attribute)
+	{
+		return 1u << static_cast<uint32_t>(attribute);
+	}
+
+	constexpr VertexAttributeMask allVertexAttributes = 0x1f;
+
+	// Binding read with a zero stride by attributes a layout lacks
+	constexpr uint32_t vertexDefaultsBinding = 1;
+
+	/**
+	 * Values shaders read for attributes a layout lacks, stored once in a
+	 * buffer bound to vertexDefaultsBinding.
+	 **/
+	inline const Vertex defaultVertex{
+		.position = glm::vec3(0.0f),
+		.color = glm::vec3(1.0f),
+		.normal = glm::vec3(0.0f),
+		.texCoord = glm::vec2(0.0f),
+		.texCoord1 = glm::vec2(0.0f)
+	};
+
+	// Maps packed positions back to model space, see Node::positionOffset
+	struct PositionQuantization
+	{
+		glm::vec3 offset = glm::vec3(0.0f);
+		glm::vec3 scale = glm::vec3(1.0f);
+	};
+
+	// fp32 encoding, the Vertex member as is
+	template <VertexAttribute A>
+	struct VertexAttributeTraits;
+
+	template <auto Member, vk::Format Format>
+	struct FloatAttributeTraits
+	{
+		static constexpr auto member = Member;
+		static constexpr auto format = Format;
+
+		using Type = std::remove_cvref_t<
+			decltype(std::declval<Vertex>().*Member)>;
+
+		static Type encode(const Vertex& vertex, const PositionQuantization&)
+		{
+			return vertex.*Member;
+		}
+	};
+
+	template <>
+	struct VertexAttributeTraits<VertexAttribute::ePosition>
+		: FloatAttributeTraits<&Vertex::position, vk::Format::eR32G32B32Sfloat>
+	{
+	};
+
+	template <>
+	struct VertexAttributeTraits<VertexAttribute::eColor>
+		: FloatAttributeTraits<&Vertex::color, vk::Format::eR32G32B32Sfloat>
+	{
+	};
+
+	template <>
+	struct VertexAttributeTraits<VertexAttribute::eNormal>
+		: FloatAttributeTraits<&Vertex::normal, vk::Format::eR32G32B32Sfloat>
+	{
+	};
+
+	template <>
+	struct VertexAttributeTraits<VertexAttribute::eTexCoord0>
+		: FloatAttributeTraits<&Vertex::texCoord, vk::Format::eR32G32Sfloat>
+	{
+	};
+
+	template <>
+	struct VertexAttributeTraits<VertexAttribute::eTexCoord1>
+		: FloatAttributeTraits<&Vertex::texCoord1, vk::Format::eR32G32Sfloat>
+	{
+	};
+
+	// VertexFormat::ePacked encoding, see PackedVertex
+	template <VertexAttribute A>
+	struct PackedAttributeTraits;
+
+	template <>
+	struct PackedAttributeTraits<VertexAttribute::ePosition>
+	{
+		using Type = PackedVertex::Position;
+		static constexpr auto format = vk::Format::eR16G16B16A16Unorm;
+
+		static Type encode(const Vertex& vertex,
+		                   const PositionQuantization& quantization)
+		{
+			return PackedVertex::packPosition(
+				vertex.position, quantization.offset, quantization.scale);
+		}
+	};
+
+	template <>
+	struct PackedAttributeTraits<VertexAttribute::eColor>
+	{
+		using Type = PackedVertex::Color;
+		static constexpr auto format = vk::Format::eR8G8B8A8Unorm;
+
+		static Type encode(const Vertex& vertex, const PositionQuantization&)
+		{
+			return PackedVertex::packColor(vertex.color);
+		}
+	};
+
+	template <>
+	struct PackedAttributeTraits<VertexAttribute::eNormal>
+	{
+		using Type = PackedVertex::Normal;
+		static constexpr auto format = vk::Format::eR16G16Snorm;
+
+		static Type encode(const Vertex& vertex, const PositionQuantization&)
+		{
+			return PackedVertex::packNormal(vertex.normal);
+		}
+	};
+
+	template <>
+	struct PackedAttributeTraits<VertexAttribute::eTexCoord0>
+	{
+		using Type = PackedVertex::TexCoord;
+		static constexpr auto format = vk::Format::eR16G16Sfloat;
+
+		static Type encode(const Vertex& vertex, const PositionQuantization&)
+		{
+			return PackedVertex::packTexCoord(vertex.texCoord);
+		}
+	};
+
+	template <>
+	struct PackedAttributeTraits<VertexAttribute::eTexCoord1>
+	{
+		using Type = PackedVertex::TexCoord;
+		static constexpr auto format = vk::Format::eR16G16Sfloat;
+
+		static Type encode(const Vertex& vertex, const PositionQuantization&)
+		{
+			return PackedVertex::packTexCoord(vertex.texCoord1);
+		}
+	};
+
+	/**
+	 * Tightly packed vertex made of the given attributes, in order, each
+	 * one encoded by Traits. The struct, its offsets, its pipeline
+	 * descriptions and its conversions from Vertex are all generated at
+	 * compile time.
+	 **/
+	template <template <VertexAttribute> typename Traits,
+	          VertexAttribute... Attributes>
+	struct BasicVertexLayout
+	{
+		template <VertexAttribute A>
+		using AttributeType = typename Traits<A>::Type;
+
+		static constexpr VertexAttributeMask mask = (toMask(Attributes) | ...);
+
+		static constexpr uint32_t stride = static_cast<uint32_t>(
+			(sizeof(AttributeType<Attributes>) + ...));
+
+		template <VertexAttribute A>
+		static constexpr uint32_t offsetOf()
+		{
+			static_assert(((Attributes == A) || ...),
+				"Attribute not in the layout");
+
+			uint32_t offset = 0;
+			auto found = false;
+
+			((found = found || Attributes == A,
+				offset += found
+					          ? 0
+					          : static_cast<uint32_t>(
+						          sizeof(AttributeType<Attributes>))), ...);
+
+			return offset;
+		}
+
+		struct alignas(4) Type
+		{
+			unsigned char bytes[stride];
+
+			template <VertexAttribute A>
+			AttributeType<A> get() const
+			{
+				AttributeType<A> value;
+				memcpy(&value, bytes + offsetOf<A>(), sizeof value);
+				return value;
+			}
+
+			template <VertexAttribute A>
+			void set(const AttributeType<A>& value)
+			{
+				memcpy(bytes + offsetOf<A>(), &value, sizeof value);
+			}
+		};
+
+		static_assert(sizeof(Type) == stride);
+
+		static Type encode(const Vertex& vertex,
+		                   const PositionQuantization& quantization = {})
+		{
+			Type packed;
+			(packed.template set<Attributes>(
+				Traits<Attributes>::encode(vertex, quantization)), ...);
+			return packed;
+		}
+
+		// fp32 layouts only
+		static Vertex decode(const Type& packed)
+		{
+			auto vertex = defaultVertex;
+			((vertex.*Traits<Attributes>::member =
+				packed.template get<Attributes>()), ...);
+			return vertex;
+		}
+
+		static std::vector<Type> encode(const std::span<const Vertex> vertices)
+		{
+			std::vector<Type> packed(vertices.size());
+
+			std::transform(std::execution::par, vertices.begin(),
+			               vertices.end(), packed.begin(),
+			               [](const Vertex& vertex)
+			               {
+				               return encode(vertex);
+			               });
+
+			return packed;
+		}
+
+		static std::vector<vk::VertexInputBindingDescription>
+		getBindingDescriptions()
+		{
+			std::vector<vk::VertexInputBindingDescription> descriptions = {
+				{
+					.binding = 0,
+					.stride = stride,
+					.inputRate = vk::VertexInputRate::eVertex
+				}
+			};
+
+			if (mask != allVertexAttributes)
+			{
+				descriptions.push_back({
+					.binding = vertexDefaultsBinding,
+					.stride = 0,
+					.inputRate = vk::VertexInputRate::eVertex
+				});
+			}
+
+			return descriptions;
+		}
+
+		static std::vector<vk::VertexInputAttributeDescription>
+		getAttributeDescriptions()
+		{
+			std::vector<vk::VertexInputAttributeDescription> descriptions;
+
+			const auto addAttribute = [&]<VertexAttribute A>()
+			{
+				const auto inLayout = (mask & toMask(A)) != 0;
+
+				// Defaults are fp32 whatever the encoding of the layout
+				descriptions.push_back({
+					.location = static_cast<uint32_t>(A),
+					.binding = inLayout ? 0 : vertexDefaultsBinding,
+					.format = inLayout
+						          ? Traits<A>::format
+						          : VertexAttributeTraits<A>::format,
+					.offset = inLayout
+						          ? offsetOfAny<A>()
+						          : static_cast<uint32_t>(
+							          offsetOfMember<A>())
+				});
+			};
+
+			addAttribute.template operator()<VertexAttribute::ePosition>();
+			addAttribute.template operator()<VertexAttribute::eColor>();
+			addAttribute.template operator()<VertexAttribute::eNormal>();
+			addAttribute.template operator()<VertexAttribute::eTexCoord0>();
+			addAttribute.template operator()<VertexAttribute::eTexCoord1>();
+
+			return descriptions;
+		}
+
+	private:
+
+		// offsetOf for attributes that may not be in the layout
+		template <VertexAttribute A>
+		static constexpr uint32_t offsetOfAny()
+		{
+			if constexpr (((Attributes == A) || ...))
+			{
+				return offsetOf<A>();
+			}
+			else
+			{
+				return 0;
+			}
+		}
+
+		// Offset of the attribute in defaultVertex
+		template <VertexAttribute A>
+		static size_t offsetOfMember()
+		{
+			const auto& member =
+				defaultVertex.*VertexAttributeTraits<A>::member;
+
+			return reinterpret_cast<const unsigned char*>(&member)
+				- reinterpret_cast<const unsigned char*>(&defaultVertex);
+		}
+	};
+
+	template <VertexAttribute... Attributes>
+	using VertexLayout = BasicVertexLayout<VertexAttributeTraits,
+	                                       Attributes...>;
+
+	template <VertexAttribute... Attributes>
+	using PackedVertexLayout = BasicVertexLayout<PackedAttributeTraits,
+	                                             Attributes...>;
+
+	static_assert(VertexLayout<
+		              VertexAttribute::ePosition,
+		              VertexAttribute::eColor,
+		              VertexAttribute::eNormal,
+		              VertexAttribute::eTexCoord0,
+		              VertexAttribute::eTexCoord1>::stride == sizeof(Vertex));
+
+	/**
+	 * Calls visitor with the smallest predefined layout holding every
+	 * attribute of the mask, encoded by Traits.
+	 **/
+	template <template <VertexAttribute> typename Traits,
+	          typename Visitor>
+	decltype(auto) visitVertexLayout(const VertexAttributeMask attributes,
+	                                 Visitor&& visitor)
+	{
+		using PositionNormalLayout = BasicVertexLayout<
+			Traits,
+			VertexAttribute::ePosition,
+			VertexAttribute::eNormal>;
+
+		using PositionNormalUvLayout = BasicVertexLayout<
+			Traits,
+			VertexAttribute::ePosition,
+			VertexAttribute::eNormal,
+			VertexAttribute::eTexCoord0>;
+
+		using PositionNormalUv2Layout = BasicVertexLayout<
+			Traits,
+			VertexAttribute::ePosition,
+			VertexAttribute::eNormal,
+			VertexAttribute::eTexCoord0,
+			VertexAttribute::eTexCoord1>;
+
+		using FullVertexLayout = BasicVertexLayout<
+			Traits,
+			VertexAttribute::ePosition,
+			VertexAttribute::eColor,
+			VertexAttribute::eNormal,
+			VertexAttribute::eTexCoord0,
+			VertexAttribute::eTexCoord1>;
+
+		if ((attributes & ~PositionNormalLayout::mask) == 0)
+		{
+			return visitor(PositionNormalLayout{});
+		}
+
+		if ((attributes & ~PositionNormalUvLayout::mask) == 0)
+		{
+			return visitor(PositionNormalUvLayout{});
+		}
+
+		if ((attributes & ~PositionNormalUv2Layout::mask) == 0)
+		{
+			return visitor(PositionNormalUv2Layout{});
+		}
+
+		return visitor(FullVertexLayout{});
+	}
+
+	// Calls visitor with the layout of the format holding the attributes
+	template <typename Visitor>
+	decltype(auto) visitVertexLayout(const VertexFormat format,
+	                                 const VertexAttributeMask attributes,
+	                                 Visitor&& visitor)
+	{
+		if (format == VertexFormat::ePacked)
+		{
+			return visitVertexLayout<PackedAttributeTraits>(
+				attributes, std::forward<Visitor>(visitor));
+		}
+
+		return visitVertexLayout<VertexAttributeTraits>(
+			attributes, std::forward<Visitor>(visitor));
+	}
+
+	inline std::vector<vk::VertexInputBindingDescription>
+	getBindingDescriptions(const VertexFormat format,
+	                       const VertexAttributeMask attributes)
+	{
+		return visitVertexLayout(format, attributes,
+		                         []<typename Layout>(Layout)
+		                         {
+			                         return Layout::getBindingDescriptions();
+		                         });
+	}
+
+	inline std::vector<vk::VertexInputAttributeDescription>
+	getAttributeDescriptions(const VertexFormat format,
+	                         const VertexAttributeMask attributes)
+	{
+		return visitVertexLayout(format, attributes,
+		                         []<typename Layout>(Layout)
+		                         {
+			                         return Layout::getAttributeDescriptions();
+		                         });
+	}
+}
@@ -137,7 +137,7 @@ namespace mvk
 
 		static Buffer allocateStagingTransferBuffer(
 			const vma::Allocator allocator,
-			void* data,
+			const void* data,
 			const vk::DeviceSize size)
 		{
 			const vk::BufferCreateInfo bufferCreateInfo = {
@@ -152,6 +152,34 @@ namespace mvk
 			return buffer;
 		}
 
+		// Left for the caller to fill through mappedData
+		static Buffer allocateMappedStagingBuffer(
+			const vma::Allocator allocator,
+			const vk::DeviceSize size,
+			void*& mappedData)
+		{
+			const vk::BufferCreateInfo bufferCreateInfo = {
+				.size = size,
+				.usage = vk::BufferUsageFlagBits::eTransferSrc,
+				.sharingMode = vk::SharingMode::eExclusive
+			};
+
+			const vma::AllocationCreateInfo allocationCreateInfo = {
+				.flags = vma::AllocationCreateFlagBits::eMapped,
+				.usage = vma::MemoryUsage::eCpuToGpu
+			};
+
+			vma::AllocationInfo allocationInfo = {};
+
+			const auto result = allocator.createBuffer(bufferCreateInfo,
+			                                           allocationCreateInfo,
+			                                           allocationInfo);
+
+			mappedData = allocationInfo.pMappedData;
+
+			return {result.first, result.second};
+		}
+
 		static void mapMemory(const vma::Allocator allocator,
 		                      const Buffer buffer, void* data)
 		{
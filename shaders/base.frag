@@ -61,6 +61,8 @@ vec3 getNormal()
 	// http://www.thetenthplanet.de/archives/1180
 	vec3 tangentNormal = texture(normalMap, inUV0).xyz * 2.0 - 1.0;
 	tangentNormal.y = -tangentNormal.y;
+	// Two channel (BC5) maps store x and y only
+	tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
 
 	vec3 q1 = dFdx(inWordPosition);
 	vec3 q2 = dFdy(inWordPosition);
@@ -79,7 +81,8 @@ void main() {
 
 	outColor = vec4(0);
 
-	vec4 baseColor = baseTextureSet > -1 ? sRgbToLinear(texture(baseColorMap, inUV0)) * baseColorFactor : baseColorFactor;
+	// Base color maps use sRGB formats, the sampler returns linear values
+	vec4 baseColor = baseTextureSet > -1 ? texture(baseColorMap, inUV0) * baseColorFactor : baseColorFactor;
 	vec4 omr = vec4(1, roughnessFactor, metallicFactor, 0);
 	vec4 mR = metallicRoughnessTextureSet > -1 ? texture(metallicRoughnessMap, inUV0) * omr : omr;
 
@@ -10,8 +10,13 @@ layout(binding = 0) uniform UniformBufferObject {
 
 layout(set = 1, binding = 0) uniform localMatrixBufferObject {
     mat4 matrix;
+    vec4 positionOffset;
+    vec4 positionScale;
 } nodeUbo;
 
+// VertexFormat::ePacked: normalized positions, octahedral normals
+layout(constant_id = 0) const bool PACKED_VERTICES = false;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec3 inNormal;
@@ -29,11 +34,24 @@ out gl_PerVertex {
     vec4 gl_Position;
 };
 
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main() {
-	vec4 localPos = nodeUbo.matrix * vec4(inPosition, 1.0);
+	// Identity for full vertices
+	vec3 position = nodeUbo.positionOffset.xyz + inPosition * nodeUbo.positionScale.xyz;
+	vec3 vertexNormal = PACKED_VERTICES ? decodeOctahedral(inNormal.xy) : inNormal;
+
+	vec4 localPos = nodeUbo.matrix * vec4(position, 1.0);
 	worldPosition = localPos.xyz / localPos.w;   
     gl_Position = ubo.proj * ubo.view * ubo.model * vec4(worldPosition, 1.0);
-	normal = normalize(transpose(inverse(mat3(ubo.model * nodeUbo.matrix))) * inNormal);
+	normal = normalize(transpose(inverse(mat3(ubo.model * nodeUbo.matrix))) * vertexNormal);
 	eyePosition = ubo.eye.xyz;
 	vertexColor = inColor;
     texCoord = inUV0;